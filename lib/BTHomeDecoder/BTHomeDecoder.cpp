@@ -1,27 +1,119 @@
 #include "BTHomeDecoder.h"
+#include "hexcodec.hpp"
 
-// Declaration for stringToHexString from blescan.cpp
-bool stringToHexString(const String &str, String &hexStr);
+// ----------------------------
+//  Object descriptors
+// ----------------------------
+namespace {
+
+struct ObjectDef {
+    uint8_t id;
+    BTHomeObject object;
+};
+
+constexpr BTHomeObject UNKNOWN_OBJECT = {-1, false, false, 1.0f, "unknown", ""};
+
+//   id       length signed lengthByte factor name unit
+constexpr ObjectDef OBJECT_DEFS[] = {
+    {0x00, { 1, false, false, 1.0f,      "packet_id", ""}},
+    {0x01, { 1, false, false, 1.0f,      "battery_percent", "percent"}},
+    {0x02, { 2, true,  false, 0.01f,     "temperature", "°C"}},
+    {0x03, { 2, false, false, 0.01f,     "humidity", "percent"}},
+    {0x04, { 3, false, false, 0.01f,     "pressure", "hPa"}},
+    {0x05, { 3, false, false, 0.01f,     "illuminance", "lux"}},
+    {0x06, {-1, false, false, 1.0f,      "unknown", "kg"}},
+    {0x07, {-1, false, false, 1.0f,      "unknown", "lb"}},
+    {0x08, { 2, true,  false, 0.01f,     "unknown", "°C"}},
+    {0x0A, { 3, false, false, 0.001f,    "energy", "kWh"}},
+    {0x0B, { 3, false, false, 0.01f,     "power", "W"}},
+    {0x0C, { 2, false, false, 0.001f,    "battery_voltage", "V"}},
+    {0x0D, {-1, false, false, 1.0f,      "unknown", "ug/m3"}},
+    {0x0E, {-1, false, false, 1.0f,      "unknown", "ug/m3"}},
+    {0x12, { 2, false, false, 1.0f,      "CO2", "ppm"}},
+    {0x13, { 2, false, false, 1.0f,      "VOC", "ug/m3"}},
+    {0x14, { 2, false, false, 0.01f,     "moisture", "percent"}},
+    {0x2E, { 1, false, false, 1.0f,      "humidity", "percent"}},
+    {0x2F, { 1, false, false, 1.0f,      "soil_moisture", "percent"}},
+    {0x3A, { 1, false, false, 1.0f,      "button", ""}},
+    {0x3C, { 2, false, false, 1.0f,      "dimmer", ""}},
+    {0x3E, { 4, false, false, 1.0f,      "unknown", ""}},
+    {0x3F, {-1, true,  false, 0.1f,      "unknown", "°"}},
+    {0x40, { 2, false, false, 1.0f,      "distance_mm", "mm"}},
+    {0x41, { 2, false, false, 0.1f,      "distance_m", "m"}},
+    {0x42, { 3, false, false, 0.001f,    "duration_sec", "s"}},
+    {0x43, { 2, false, false, 0.001f,    "current_A", "A"}},
+    {0x44, { 2, false, false, 0.01f,     "speed_mps", "m/s"}},
+    {0x45, { 2, true,  false, 0.1f,      "temperature_0.1C", "°C"}},
+    {0x46, { 2, false, false, 0.1f,      "UV_index", ""}},
+    {0x47, { 2, false, false, 0.1f,      "volume_liters", "L"}},
+    {0x48, { 2, false, false, 1.0f,      "volume_milliliters", "mL"}},
+    {0x49, { 3, false, false, 1.0f,      "flow_rate", "m3/hr"}},
+    {0x4A, {-1, false, false, 0.1f,      "voltage_V", "V"}},
+    {0x4B, { 3, false, false, 0.001f,    "gas_m3", "m3"}},
+    {0x4C, { 4, false, false, 0.001f,    "unknown", "m3"}},
+    {0x4D, { 4, false, false, 0.001f,    "unknown", "kWh"}},
+    {0x4E, { 4, false, false, 0.001f,    "unknown", "L"}},
+    {0x4F, { 4, false, false, 0.001f,    "unknown", "L"}},
+    {0x50, { 4, false, false, 1.0f,      "timestamp", ""}},
+    {0x51, { 2, false, false, 0.001f,    "unknown", "m/s²"}},
+    {0x52, { 2, false, false, 0.001f,    "unknown", "°/s"}},
+    {0x53, {-1, false, true,  1.0f,      "text", ""}},
+    {0x54, {-1, false, true,  1.0f,      "raw", ""}},
+    {0x55, {-1, false, false, 1.0f,      "volume_storage", ""}},
+    {0x56, { 2, false, false, 1.0f,      "conductivity", ""}},
+    {0x57, { 2, false, false, 1.0f,      "temperature", ""}},
+    {0x58, { 2, false, false, 1.0f,      "temperature", ""}},
+    {0x59, {-1, false, false, 1.0f,      "count", ""}},
+    {0x5A, {-1, false, false, 1.0f,      "count", ""}},
+    {0x5B, { 4, false, false, 1.0f,      "count", ""}},
+    {0x5C, { 4, false, false, 0.01f,     "power", ""}},
+    {0x5D, { 2, false, false, 0.001f,    "current", ""}},
+    {0x5E, { 2, false, false, 0.01f,     "direction", ""}},
+    {0x5F, { 2, false, false, 0.1f,      "precipitation", ""}},
+    {0x60, { 1, false, false, 1.0f,      "channel", ""}},
+    {0x61, { 2, false, false, 1.0f,      "rotational_speed", ""}},
+    {0x62, { 4, true,  false, 0.000001f, "speed", "m/s"}},
+    {0x63, { 4, true,  false, 0.000001f, "acceleration", "m/s²"}},
+    {0xF0, { 2, false, false, 1.0f,      "device_type_id", ""}},
+    {0xF1, { 4, false, false, 1.0f,      "firmware_version", ""}},
+    {0xF2, { 3, false, false, 1.0f,      "firmware_version", ""}},
+};
+
+struct ObjectTable {
+    BTHomeObject entry[256];
+};
+
+// Dense table indexed by object ID, built at compile time
+constexpr ObjectTable buildObjectTable() {
+    ObjectTable t = {};
+    for (BTHomeObject &e : t.entry)
+        e = UNKNOWN_OBJECT;
+    for (const ObjectDef &d : OBJECT_DEFS)
+        t.entry[d.id] = d.object;
+    return t;
+}
+
+constexpr ObjectTable OBJECTS = buildObjectTable();
+
+} // namespace
+
+const BTHomeObject &bthomeObject(uint8_t objID) {
+    return OBJECTS.entry[objID];
+}
 
 // ----------------------------
 //  parseBTHomeV2
 // ----------------------------
-BTHomeDecodeResult BTHomeDecoder::parseBTHomeV2(
-    // const std::vector<uint8_t> &serviceData,
-    const std::string &serviceData,
-    const std::string &macString,
-    const std::string &keyHex) {
-    BTHomeDecodeResult result;
-    result.isBTHome = false;
-    result.isBTHomeV2 = false;
-    result.bthomeVersion = 0;
-    result.isEncrypted = false;
-    result.decryptionSucceeded = false;
-    result.isTriggerBased = false;
+BTHomeDecodeStatus BTHomeDecoder::parseBTHomeV2(
+    const uint8_t *serviceData, size_t len,
+    const uint8_t mac[6],
+    const uint8_t *key,
+    BTHomeMeasurement *out, size_t capacity) {
+    BTHomeDecodeStatus status = {};
 
     // Must have at least 1 byte to read the adv_info
-    if (serviceData.size() < 1) {
-        return result;
+    if (len < 1) {
+        return status;
     }
 
     uint8_t advInfo = serviceData[0];
@@ -30,120 +122,114 @@ BTHomeDecodeResult BTHomeDecoder::parseBTHomeV2(
     bool triggerBased = (advInfo & 0x04) != 0;
     uint8_t version = (advInfo >> 5) & 0x07;
 
-    result.isBTHome = true; // because presumably the 0xFCD2 service UUID was matched externally
-    result.bthomeVersion = version;
-    result.isEncrypted = encryptionFlag;
-    result.isTriggerBased = triggerBased;
+    status.isBTHome = true; // because presumably the 0xFCD2 service UUID was matched externally
+    status.bthomeVersion = version;
+    status.isEncrypted = encryptionFlag;
+    status.isTriggerBased = triggerBased;
     if (version == 2) {
-        result.isBTHomeV2 = true;
+        status.isBTHomeV2 = true;
     }
 
     // Skip over advInfo + MAC if present
     size_t index = 1;
-    // size_t index = 0;
     if (hasMac) {
-        if (serviceData.size() < 7) {
-            return result; // not enough data
+        if (len < 7) {
+            return status; // not enough data
         }
         index += 6; // skip the "reversed MAC"
     }
 
-    if (index >= serviceData.size()) {
-        return result;
+    if (index >= len || len - index > BTHOME_MAX_PAYLOAD) {
+        return status;
     }
 
-    // The remainder is payload
-    std::vector<uint8_t> payload(serviceData.begin() + index, serviceData.end());
-
-    String tempStr(reinterpret_cast<const char*>(payload.data()), payload.size());
-    String hexStr;
-    stringToHexString(tempStr, hexStr);
-    std::string hp = hexStr.c_str();
-    log_d("--DEBUG: mac=%s payload=%s", macString.c_str(), hp.c_str());
+    // The remainder is payload, parsed in place or decrypted into plain
+    const uint8_t *payload = serviceData + index;
+    size_t payloadLen = len - index;
+    uint8_t plain[BTHOME_MAX_PAYLOAD];
+
+#if defined(ARDUHAL_LOG_LEVEL) && ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_DEBUG
+    {
+        char hp[2 * BTHOME_MAX_PAYLOAD + 1];
+        char ms[18];
+        hexEncode(payload, payloadLen, hp);
+        hexFormatMac(mac, ms);
+        log_d("--DEBUG: mac=%s payload=%s", ms, hp);
+    }
+#endif
 
     // If encrypted, decrypt
     if (encryptionFlag) {
-        if (keyHex.size() != 32) {
-            // invalid key
-            return result;
-        }
-
-        uint8_t key[16];
-        for (int i = 0; i < 16; i++) {
-            String sub = String(keyHex.c_str() + i * 2, 2);
-            key[i] = (uint8_t)strtol(sub.c_str(), nullptr, 16);
-        }
-
-        // Convert MAC string to byte array (normal order)
-        uint8_t macBytes[6];
-        if (!macStringToBytes(macString, macBytes)) {
-            memset(macBytes, 0, 6); // fallback
-        }
-
         // BTHome v2: last 8 bytes in payload => [counter(4) + mic(4)]
-        if (payload.size() < 8) {
-            return result;
+        if (payloadLen < 8) {
+            return status;
         }
 
-        size_t totalLen = payload.size();
-        size_t offsetCounter = totalLen - 8;
-        // size_t offsetMic     = totalLen - 4;
-
-        uint8_t counter[4];
-        memcpy(counter, &payload[offsetCounter], 4);
-
-        // Decrypt in-place
-        std::vector<uint8_t> decrypted(totalLen);
-        size_t outLen = 0;
-        bool ok = decryptAESCCM(payload.data(), totalLen,
-                                macBytes, advInfo,
-                                key, counter,
-                                decrypted.data(), outLen);
+        size_t cipherLen = payloadLen - 8;
+        const uint8_t *mic = payload + cipherLen + 4;
+
+        // BTHome Nonce => mac(6) + 0xD2 0xFC + advInfo(1) + counter(4) = 13
+        uint8_t nonce[13];
+        memcpy(nonce, mac, 6);
+        nonce[6] = 0xD2;
+        nonce[7] = 0xFC;
+        nonce[8] = advInfo;
+        memcpy(&nonce[9], payload + cipherLen, 4);
+
+        // The key store (cached contexts) first, then the explicit key
+        BTHomeKeyStore::Result r = _keys ? _keys->decrypt(mac, nonce, payload, cipherLen, mic, plain)
+                                   : BTHomeKeyStore::Result::NoKey;
+        bool ok = r == BTHomeKeyStore::Result::Ok;
+        if (r == BTHomeKeyStore::Result::NoKey) {
+            if (key == nullptr) {
+                return status;
+            }
+            ok = decryptAESCCM(payload, cipherLen, mic, nonce, key, plain);
+        }
 
         if (!ok) {
-            return result; // decryption failed
+            return status; // decryption failed
         }
 
-        result.decryptionSucceeded = true;
-        // Replace payload with the plaintext
-        payload.resize(outLen);
-        memcpy(payload.data(), decrypted.data(), outLen);
+        status.decryptionSucceeded = true;
+        payload = plain;
+        payloadLen = cipherLen;
     } else {
-        result.decryptionSucceeded = true;
+        status.decryptionSucceeded = true;
     }
 
     // Parse objects
     size_t idx = 0;
-    while (idx < payload.size()) {
+    while (idx < payloadLen) {
         int dataLen;
 
-        log_v("DEBUG: idx=%d, payload.size()=%d", idx, payload.size());
-        if (idx + 1 > payload.size())
-            break;
+        log_v("DEBUG: idx=%u, payloadLen=%u", (unsigned)idx, (unsigned)payloadLen);
         uint8_t objID = payload[idx];
         idx++; // skip over objId
-        if (hasLengthByte(objID)) {
+        const BTHomeObject &obj = bthomeObject(objID);
+        if (obj.lengthByte) {
+            if (idx >= payloadLen)
+                break;
             // skip over length byte
             dataLen = payload[idx];
             idx++;
         } else {
-            dataLen = getObjectDataLength(objID);
+            dataLen = obj.length;
         }
         log_v("DEBUG: objectID=0x%02X dataLen=%d", objID, dataLen);
         if (dataLen < 0) {
             log_d("DEBUG: Unknown objectID => stopping parse");
             break;
         }
-        if (idx + dataLen > payload.size()) {
-            log_d("DEBUG: Not enough bytes => stopping parse idx=%d dataLen=%d pl=%d", idx, dataLen, payload.size());
+        if (idx + dataLen > payloadLen) {
+            log_d("DEBUG: Not enough bytes => stopping parse idx=%u dataLen=%d pl=%u",
+                  (unsigned)idx, dataLen, (unsigned)payloadLen);
             break;
         }
 
-        float factor = getObjectFactor(objID);
-        bool isSigned = getObjectSignedNess(objID);
-        // if (objID == 0x02) isSigned = true; // example
+        float factor = obj.factor;
         float val = 0.0f;
-        if (isSigned) {
+        if (obj.isSigned) {
             val = parseSignedLittle(&payload[idx], dataLen, factor);
         } else {
             val = parseUnsignedLittle(&payload[idx], dataLen, factor);
@@ -151,59 +237,57 @@ BTHomeDecodeResult BTHomeDecoder::parseBTHomeV2(
 
         log_d("DEBUG: objID=0x%02X => val=%.2f, factor=%.3f", objID, val, factor);
 
-        BTHomeMeasurement meas;
-        meas.objectID = objID;
-        meas.value = val;
-        meas.name = getObjectName(objID);
-        meas.unit = getObjectUnit(objID);
-        meas.isValid = true;
-
-        result.measurements.push_back(meas);
+        if (status.count < capacity) {
+            BTHomeMeasurement &meas = out[status.count];
+            meas.objectID = objID;
+            meas.value = val;
+            meas.object = &obj;
+            meas.isValid = true;
+        }
+        status.count++;
 
         idx += dataLen;
     }
 
-    return result;
+    return status;
 }
 
-// ----------------------------
-//  Helper Methods
-// ----------------------------
-bool BTHomeDecoder::macStringToBytes(const std::string &macStr, uint8_t macOut[6]) {
-    std::string cleaned;
-    for (char c : macStr) {
-        if (isxdigit(c))
-            cleaned.push_back(c);
-    }
-    if (cleaned.size() != 12)
-        return false;
+BTHomeDecodeResult BTHomeDecoder::parseBTHomeV2(
+    const std::string &serviceData,
+    const std::string &macString,
+    const std::string &keyHex) {
+    BTHomeDecodeResult result = {};
 
-    for (int i = 0; i < 6; i++) {
-        std::string byteStr = cleaned.substr(i * 2, 2);
-        macOut[i] = (uint8_t)strtol(byteStr.c_str(), nullptr, 16);
+    uint8_t macBytes[6];
+    if (!hexParseMac(macString.c_str(), macBytes)) {
+        memset(macBytes, 0, 6); // fallback
     }
-    return true;
+    uint8_t key[16];
+    bool haveKey = keyHex.size() == 32 && hexDecode(keyHex.data(), keyHex.size(), key);
+
+    result.measurements.resize(BTHOME_MAX_OBJECTS);
+    BTHomeDecodeStatus status = parseBTHomeV2(
+                                    (const uint8_t *)serviceData.data(), serviceData.size(),
+                                    macBytes, haveKey ? key : nullptr,
+                                    result.measurements.data(), BTHOME_MAX_OBJECTS);
+    result.isBTHome = status.isBTHome;
+    result.isBTHomeV2 = status.isBTHomeV2;
+    result.bthomeVersion = status.bthomeVersion;
+    result.isEncrypted = status.isEncrypted;
+    result.decryptionSucceeded = status.decryptionSucceeded;
+    result.isTriggerBased = status.isTriggerBased;
+    result.measurements.resize(status.count < BTHOME_MAX_OBJECTS ? status.count
+                               : BTHOME_MAX_OBJECTS);
+    return result;
 }
 
+// ----------------------------
+//  Helper Methods
+// ----------------------------
 bool BTHomeDecoder::decryptAESCCM(
-    const uint8_t *ciphertext, size_t ciphertextLen,
-    const uint8_t *macBytes, uint8_t advInfo,
-    const uint8_t *key, const uint8_t *counter,
-    uint8_t *plaintextOut, size_t &plaintextLenOut) {
-    // BTHome Nonce => mac(6) + 0xD2 0xFC + advInfo(1) + counter(4) = 13
-    uint8_t nonce[13];
-    memcpy(nonce, macBytes, 6);
-    nonce[6] = 0xD2;
-    nonce[7] = 0xFC;
-    nonce[8] = advInfo;
-    memcpy(&nonce[9], counter, 4);
-
-    // last 4 bytes of ciphertext => MIC
-    if (ciphertextLen < 4)
-        return false;
-    size_t micLen = 4;
-    size_t rawCipherLen = ciphertextLen - micLen;
-
+    const uint8_t *ciphertext, size_t ciphertextLen, const uint8_t *mic,
+    const uint8_t *nonce, const uint8_t *key,
+    uint8_t *plaintextOut) {
     mbedtls_ccm_context ctx;
     mbedtls_ccm_init(&ctx);
     int ret = mbedtls_ccm_setkey(&ctx, MBEDTLS_CIPHER_ID_AES, key, 128);
@@ -214,341 +298,13 @@ bool BTHomeDecoder::decryptAESCCM(
 
     ret = mbedtls_ccm_auth_decrypt(
               &ctx,
-              rawCipherLen,
-              nonce, sizeof(nonce),
+              ciphertextLen,
+              nonce, 13,
               nullptr, 0, // no AAD
               ciphertext, plaintextOut,
-              (uint8_t *)(ciphertext + rawCipherLen),
-              micLen);
+              mic, 4);
     mbedtls_ccm_free(&ctx);
-
-    if (ret != 0)
-        return false;
-    plaintextLenOut = rawCipherLen;
-    return true;
-}
-
-bool BTHomeDecoder::hasLengthByte(uint8_t objID) {
-    switch (objID) {
-        case 0x53:
-        case 0x54:
-            return true;
-        default:
-            return false;
-    }
-}
-
-int BTHomeDecoder::getObjectDataLength(uint8_t objID) {
-    switch (objID) {
-        case 0x00: // packet id
-            return 1;
-        case 0x01: // battery percentage (1 byte)
-            return 1;
-        case 0x02:
-        case 0x03:
-        case 0x08:
-        case 0x0C: // battery voltage (2 bytes)
-        case 0x12:
-        case 0x13:
-        case 0x14:
-        case 0x3C:
-        case 0x40:
-        case 0x41:
-        case 0x43:
-        case 0x44:
-        case 0x45:
-        case 0x46:
-        case 0x47:
-        case 0x48:
-        case 0x51:
-        case 0x52:
-        case 0x56:
-        case 0x57:
-        case 0x58:
-        case 0x5E:
-        case 0x5F:
-            return 2;
-        case 0x04:
-        case 0x05: // illuminance (3 bytes)
-        case 0x0A:
-        case 0x0B:
-        case 0x42:
-        case 0x49:
-        case 0x4B:
-            return 3;
-        case 0x2E: // humidity (1 byte)
-        case 0x2F: // soil moisture (1 byte)
-        case 0x3A: // button
-            return 1;
-        case 0x3E:
-        case 0x4C:
-        case 0x4D:
-        case 0x4E:
-        case 0x4F:
-        case 0x50:
-        case 0x5B:
-        case 0x5C:
-            return 4;
-        case 0x5D: // current (sint16)
-        case 0x61: // rotational speed
-            return 2;
-        case 0x60: // channel
-            return 1;
-        case 0x62: // speed (signed)
-        case 0x63: // acceleration (signed)
-            return 4;
-        case 0xF0: // device type id
-            return 2;
-        case 0xF1: // firmware version (uint32)
-            return 4;
-        case 0xF2: // firmware version (uint24)
-            return 3;
-        default:
-            return -1;
-    }
-}
-
-float BTHomeDecoder::getObjectFactor(uint8_t objID) {
-    switch (objID) {
-        case 0x01:
-            // Battery % is 1 byte, 0..100 => factor = 1 => raw 98 => 98%
-            return 1.0f;
-        case 0x02:
-        case 0x03:
-        case 0x08:
-        case 0x14:
-            return 0.01f;
-        case 0x04:
-        case 0x0B:
-            return 0.01f;
-        case 0x05:
-            // Illuminance is 3 bytes * factor 0.01 => e.g. raw = 12345 => 123.45 lux
-            // or pick a different factor if your device uses another scale.
-            return 0.01f;
-        case 0x0A:
-        case 0x0C:
-            // Battery voltage is 2 bytes in millivolts => factor = 0.001 => 3241 => 3.241 V
-            return 0.001f;
-        case 0x2E:
-            // If you stored humidity as a single byte (0-100),
-            // factor = 1.0 => final value = raw (like 55 => 55%)
-            return 1.0f;
-        case 0x2F:
-            // Soil moisture is 1 byte, 0..100 => factor = 1 => raw 47 => 47%
-            return 1.0f;
-        case 0x3F:
-        case 0x5F: // precipitation
-            return 0.1f;
-        case 0x45:
-        case 0x46:
-        case 0x47:
-        case 0x4A:
-        case 0x41: // distance (m)
-            return 0.1f;
-        case 0x42:
-        case 0x43:
-        case 0x4B:
-        case 0x4C:
-        case 0x4D:
-        case 0x4E:
-        case 0x4F:
-        case 0x51:
-        case 0x52:
-        case 0x5D: // current (sint16)
-            return 0.001f;
-        case 0x44:
-        case 0x5C:
-        case 0x5E:
-            return 0.01f;
-        case 0x62: // speed (signed)
-        case 0x63: // acceleration (signed)
-            return 0.000001f;
-        default:
-            return 1.0f;
-    }
-}
-
-bool BTHomeDecoder::getObjectSignedNess(uint8_t objID) {
-    switch (objID) {
-        case 0x02: // temperature
-        case 0x08: // dewpoint
-        case 0x3F: // rotation
-        case 0x45: // temperature
-        case 0x62: // speed (signed)
-        case 0x63: // acceleration (signed)
-            return true;
-        default:
-            return false;
-    }
-}
-
-String BTHomeDecoder::getObjectUnit(uint8_t objID) {
-    switch (objID) {
-        case 0x01: // battery
-        case 0x03: // humidity
-        case 0x14: // moisture
-        case 0x2E: // humidity
-        case 0x2F: // moisture
-            return "percent";
-        case 0x02: // temperature
-        case 0x08: // dewpoint
-        case 0x45: // temperature
-            return "°C";
-        case 0x04: // pressure
-            return "hPa";
-        case 0x05: // illuminance
-            return "lux";
-        case 0x06: // mass (kg)
-            return "kg";
-        case 0x07: // mass (lb)
-            return "lb";
-        case 0x0A: // energy
-        case 0x4D: // energy
-            return "kWh";
-        case 0x0B: // power
-            return "W";
-        case 0x0C: // voltage
-        case 0x4A: // voltage
-            return "V";
-        case 0x0D: // pm2.5
-        case 0x0E: // pm10
-        case 0x13: // tvoc
-            return "ug/m3";
-        case 0x12: // co2
-            return "ppm";
-        case 0x3F: // rotation
-            return "°";
-        case 0x40: // distance (mm)
-            return "mm";
-        case 0x41: // distance (m)
-            return "m";
-        case 0x42: // duration
-            return "s";
-        case 0x43: // current
-            return "A";
-        case 0x44: // speed
-        case 0x62: // speed
-            return "m/s";
-        case 0x47: // volume
-        case 0x4E: // volume
-        case 0x4F: // water
-            return "L";
-        case 0x48: // volume
-            return "mL";
-        case 0x49: // volume Flow Rate
-            return "m3/hr";
-        case 0x4B: // gas
-        case 0x4C: // gas
-            return "m3";
-        case 0x51: // acceleration
-        case 0x63: // acceleration
-            return "m/s²";
-        case 0x52: // gyroscope
-            return "°/s";
-        default:
-            return "";
-    }
-}
-
-String BTHomeDecoder::getObjectName(uint8_t objID) {
-    switch (objID) {
-        case 0x00:
-            return "packet_id";
-        case 0x01:
-            return "battery_percent";
-        case 0x02:
-            return "temperature";
-        case 0x03:
-            return "humidity";
-        case 0x04:
-            return "pressure";
-        case 0x05:
-            return "illuminance";
-        case 0x0A:
-            return "energy";
-        case 0x0B:
-            return "power";
-        case 0x0C:
-            return "battery_voltage";
-        case 0x12:
-            return "CO2";
-        case 0x13:
-            return "VOC";
-        case 0x14:
-            return "moisture";
-        case 0x2E:
-            return "humidity";
-        case 0x2F:
-            return "soil_moisture";
-        case 0x3A:
-            return "button";
-        case 0x3C:
-            return "dimmer";
-        case 0x40:
-            return "distance_mm";
-        case 0x41:
-            return "distance_m";
-        case 0x42:
-            return "duration_sec";
-        case 0x43:
-            return "current_A";
-        case 0x44:
-            return "speed_mps";
-        case 0x45:
-            return "temperature_0.1C";
-        case 0x46:
-            return "UV_index";
-        case 0x47:
-            return "volume_liters";
-        case 0x48:
-            return "volume_milliliters";
-        case 0x49:
-            return "flow_rate";
-        case 0x4A:
-            return "voltage_V";
-        case 0x4B:
-            return "gas_m3";
-        case 0x50:
-            return "timestamp";
-        case 0x53:
-            return "text";
-        case 0x54:
-            return "raw";
-        case 0x55:
-            return "volume_storage";
-        case 0x56:
-            return "conductivity";
-        case 0x57:
-        case 0x58:
-            return "temperature";
-        case 0x59:
-        case 0x5A:
-        case 0x5B:
-            return "count";
-        case 0x5C:
-            return "power";
-        case 0x5D:
-            return "current";
-        case 0x5E:
-            return "direction";
-        case 0x5F:
-            return "precipitation";
-        case 0x60:
-            return "channel";
-        case 0x61:
-            return "rotational_speed";
-        case 0x62:
-            return "speed";
-        case 0x63:
-            return "acceleration";
-        case 0xF0:
-            return "device_type_id";
-        case 0xF1:
-        case 0xF2:
-            return "firmware_version";
-        default:
-            return "unknown";
-    }
+    return ret == 0;
 }
 
 float BTHomeDecoder::parseSignedLittle(const uint8_t *data, size_t len, float factor) {
@@ -1,21 +1,53 @@
 #pragma once
 
-#include <Arduino.h>
+#ifdef ESP_PLATFORM
+    #include <Arduino.h>
+#else
+    #include "hostport.hpp"
+#endif
 #include <vector>
 #include <string>
 #include "mbedtls/ccm.h"
+#include "BTHomeKeyStore.h"
 
 // ------------------------------------------------------------
 //  Structs
 // ------------------------------------------------------------
+// Static description of a BTHome object ID
+struct BTHomeObject {
+    int8_t length;      // data bytes, -1 if unknown (parsing stops there)
+    bool isSigned;
+    bool lengthByte;    // variable length, data preceded by a length byte
+    float factor;
+    const char *name;
+    const char *unit;   // "" if none
+};
+
+// Descriptor for objID; IDs without one have length -1 and name "unknown"
+const BTHomeObject &bthomeObject(uint8_t objID);
+
 struct BTHomeMeasurement {
     uint8_t objectID;
     float value;
-    String name;
+    const BTHomeObject *object; // name, unit
     bool isValid;
-    String unit;
 };
 
+// Header fields of a packet decoded by the allocation-free parseBTHomeV2()
+struct BTHomeDecodeStatus {
+    bool isBTHome;
+    bool isBTHomeV2;
+    uint8_t bthomeVersion;
+    bool isEncrypted;
+    bool decryptionSucceeded;
+    bool isTriggerBased;
+    size_t count;       // objects decoded; only the first `capacity` are stored
+};
+
+// Service data payload bounds (one AD element)
+static constexpr size_t BTHOME_MAX_PAYLOAD = 255;
+static constexpr size_t BTHOME_MAX_OBJECTS = BTHOME_MAX_PAYLOAD / 2;
+
 struct BTHomeDecodeResult {
     bool isBTHome;
     bool isBTHomeV2;
@@ -34,26 +66,39 @@ public:
     BTHomeDecoder() {}
     ~BTHomeDecoder() {}
 
+    // Look up per-device keys (and the store's default key) here before
+    // falling back to the key passed to parseBTHomeV2(). nullptr disables.
+    void setKeyStore(BTHomeKeyStore* keys) {
+        _keys = keys;
+    }
+
     BTHomeDecodeResult parseBTHomeV2(
-        // const std::vector<uint8_t>& serviceData,
         const std::string& serviceData,
         const std::string& macString,
         const std::string& keyHex
     );
 
+    // Allocation-free variant: serviceData is the payload after the 0xFCD2
+    // UUID, mac the advertiser address in display order, key the 16-byte
+    // AES key (nullptr if none). Decrypts into a stack buffer and stores
+    // up to `capacity` measurements in `out`. Keys from the key store use
+    // its cached contexts; an explicit key sets up a CCM context for the
+    // call, which mbedtls allocates.
+    BTHomeDecodeStatus parseBTHomeV2(
+        const uint8_t* serviceData, size_t len,
+        const uint8_t mac[6],
+        const uint8_t* key,
+        BTHomeMeasurement* out, size_t capacity
+    );
+
 private:
     // Helper methods
-    bool   macStringToBytes(const std::string &macStr, uint8_t macOut[6]);
+    // One-off decryption with a key that is not in the key store
     bool   decryptAESCCM(const uint8_t* ciphertext, size_t ciphertextLen,
-                         const uint8_t* macBytes, uint8_t advInfo,
-                         const uint8_t* key, const uint8_t* counter,
-                         uint8_t* plaintextOut, size_t &plaintextLenOut);
-    bool hasLengthByte(uint8_t objID);
-    int    getObjectDataLength(uint8_t objID);
-    float  getObjectFactor(uint8_t objID);
-    bool   getObjectSignedNess(uint8_t objID);
-    String getObjectUnit(uint8_t objID);
-    String getObjectName(uint8_t objID);
+                         const uint8_t* mic, const uint8_t* nonce,
+                         const uint8_t* key, uint8_t* plaintextOut);
+
+    BTHomeKeyStore* _keys = nullptr;
 
     float  parseSignedLittle(const uint8_t* data, size_t len, float factor);
     float  parseUnsignedLittle(const uint8_t* data, size_t len, float factor);
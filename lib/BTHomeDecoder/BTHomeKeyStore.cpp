@@ -0,0 +1,205 @@
+#include "BTHomeKeyStore.h"
+
+#include <cstdio>
+#include <cstring>
+#ifdef ESP_PLATFORM
+    #include <Arduino.h>
+    #include "nvs.h"
+#else
+    #include "hostport.hpp"
+#endif
+#include "hexcodec.hpp"
+
+BTHomeKeyStore::~BTHomeKeyStore() {
+    clear();
+    setDefaultKey(nullptr);
+}
+
+bool BTHomeKeyStore::setup(mbedtls_ccm_context &ctx, const uint8_t key[16]) {
+    mbedtls_ccm_init(&ctx);
+    if (mbedtls_ccm_setkey(&ctx, MBEDTLS_CIPHER_ID_AES, key, 128) != 0) {
+        mbedtls_ccm_free(&ctx);
+        return false;
+    }
+    return true;
+}
+
+size_t BTHomeKeyStore::lowerBound(uint64_t key) const {
+    size_t lo = 0, hi = _entries.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (_entries[mid]->key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+bool BTHomeKeyStore::add(const uint8_t mac[6], const uint8_t key[16]) {
+    std::unique_ptr<Entry> e(new Entry());
+    e->key = macKey(mac);
+    if (!setup(e->ctx, key))
+        return false;
+
+    std::lock_guard<std::mutex> guard(_lock);
+    size_t i = lowerBound(e->key);
+    if (i < _entries.size() && _entries[i]->key == e->key) {
+        mbedtls_ccm_free(&_entries[i]->ctx);
+        _entries[i] = std::move(e);
+    } else {
+        _entries.insert(_entries.begin() + i, std::move(e));
+    }
+    return true;
+}
+
+bool BTHomeKeyStore::add(const char *mac, const char *hexKey) {
+    uint8_t m[6], key[16];
+    if (!mac || !hexKey || !hexParseMac(mac, m) || strlen(hexKey) != 2 * sizeof(key) ||
+            !hexDecode(hexKey, 2 * sizeof(key), key))
+        return false;
+    return add(m, key);
+}
+
+bool BTHomeKeyStore::remove(const uint8_t mac[6]) {
+    uint64_t k = macKey(mac);
+    std::lock_guard<std::mutex> guard(_lock);
+    size_t i = lowerBound(k);
+    if (i == _entries.size() || _entries[i]->key != k)
+        return false;
+    mbedtls_ccm_free(&_entries[i]->ctx);
+    _entries.erase(_entries.begin() + i);
+    return true;
+}
+
+void BTHomeKeyStore::clear() {
+    std::lock_guard<std::mutex> guard(_lock);
+    for (auto &e : _entries)
+        mbedtls_ccm_free(&e->ctx);
+    _entries.clear();
+}
+
+bool BTHomeKeyStore::setDefaultKey(const uint8_t key[16]) {
+    std::unique_ptr<Entry> e;
+    if (key) {
+        e.reset(new Entry());
+        if (!setup(e->ctx, key))
+            return false;
+    }
+
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_default)
+        mbedtls_ccm_free(&_default->ctx);
+    _default = std::move(e);
+    return true;
+}
+
+#ifdef ESP_PLATFORM
+size_t BTHomeKeyStore::loadNvs(const char *ns) {
+    nvs_handle_t h;
+    if (nvs_open(ns, NVS_READONLY, &h) != ESP_OK)
+        return 0;
+
+    size_t n = 0;
+    nvs_iterator_t it = nullptr;
+    esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, ns, NVS_TYPE_BLOB, &it);
+    while (err == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        uint8_t mac[6], key[16];
+        size_t len = sizeof(key);
+        if (hexParseMac(info.key, mac) && nvs_get_blob(h, info.key, key, &len) == ESP_OK &&
+                len == sizeof(key) && add(mac, key))
+            n++;
+        else
+            log_w("BTHome keys: skipping NVS entry %s", info.key);
+        err = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+    nvs_close(h);
+    return n;
+}
+
+bool BTHomeKeyStore::saveNvs(const uint8_t mac[6], const uint8_t key[16], const char *ns) {
+    nvs_handle_t h;
+    if (nvs_open(ns, NVS_READWRITE, &h) != ESP_OK)
+        return false;
+    char name[13];
+    hexEncode(mac, 6, name);
+    bool ok = nvs_set_blob(h, name, key, 16) == ESP_OK && nvs_commit(h) == ESP_OK;
+    nvs_close(h);
+    return ok && add(mac, key);
+}
+#else
+size_t BTHomeKeyStore::loadNvs(const char *) {
+    return 0;
+}
+
+bool BTHomeKeyStore::saveNvs(const uint8_t *, const uint8_t *, const char *) {
+    return false;
+}
+#endif
+
+size_t BTHomeKeyStore::loadFile(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return 0;
+
+    size_t n = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        char mac[24], key[40];
+        if (sscanf(line, " %23s %39s", mac, key) != 2 || mac[0] == '#') {
+            continue;
+        }
+        if (add(mac, key))
+            n++;
+        else
+            log_w("BTHome keys: bad line in %s: %s", path, mac);
+    }
+    fclose(f);
+    return n;
+}
+
+BTHomeKeyStore::Result BTHomeKeyStore::decrypt(const uint8_t mac[6], const uint8_t nonce[13],
+                                               const uint8_t *cipher, size_t len,
+                                               const uint8_t mic[4], uint8_t *plain) {
+    uint64_t k = macKey(mac);
+    std::lock_guard<std::mutex> guard(_lock);
+    size_t i = lowerBound(k);
+    mbedtls_ccm_context *ctx;
+    if (i < _entries.size() && _entries[i]->key == k) {
+        _hits++;
+        ctx = &_entries[i]->ctx;
+    } else if (_default) {
+        _defaults++;
+        ctx = &_default->ctx;
+    } else {
+        _misses++;
+        return Result::NoKey;
+    }
+
+    int ret = mbedtls_ccm_auth_decrypt(ctx, len, nonce, 13, nullptr, 0,
+                                       cipher, plain, mic, 4);
+    if (ret != 0) {
+        _failures++;
+        return Result::Failed;
+    }
+    return Result::Ok;
+}
+
+BTHomeKeyStore::Stats BTHomeKeyStore::stats() const {
+    std::lock_guard<std::mutex> guard(_lock);
+    Stats s;
+    s.keys = (uint32_t)_entries.size();
+    s.hits = _hits;
+    s.defaults = _defaults;
+    s.misses = _misses;
+    s.failures = _failures;
+    return s;
+}
+
+size_t BTHomeKeyStore::size() const {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _entries.size();
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "mbedtls/ccm.h"
+
+// ------------------------------------------------------------
+//  BTHomeKeyStore
+// ------------------------------------------------------------
+// BTHome encryption keys by device MAC. Each key gets an mbedtls CCM
+// context when it is added, so the AES key schedule is computed once and
+// decrypting a packet costs only the CCM operation. An optional default
+// key covers devices without their own entry.
+//
+// Keys can be loaded from NVS (namespace of 16-byte blobs named by the
+// MAC as 12 hex digits) or from a text file with one "MAC KEY" pair per
+// line. decrypt() may be called from several tasks; calls are serialized.
+// Without ESP_PLATFORM there is no NVS: loadNvs() adds nothing and
+// saveNvs() fails.
+class BTHomeKeyStore {
+public:
+    enum class Result : uint8_t {
+        NoKey,   // neither a key for this device nor a default key
+        Ok,
+        Failed,  // MIC mismatch: wrong key or corrupted packet
+    };
+
+    struct Stats {
+        uint32_t keys;      // devices with their own key
+        uint32_t hits;      // packets from a device with its own key
+        uint32_t defaults;  // packets decrypted with the default key
+        uint32_t misses;    // packets with neither key
+        uint32_t failures;  // decryptions that failed the MIC check
+    };
+
+    BTHomeKeyStore() = default;
+    ~BTHomeKeyStore();
+    BTHomeKeyStore(const BTHomeKeyStore &) = delete;
+    BTHomeKeyStore &operator=(const BTHomeKeyStore &) = delete;
+
+    // Add or replace the key of one device
+    bool add(const uint8_t mac[6], const uint8_t key[16]);
+    // Same with a "AA:BB:CC:DD:EE:FF" (separators optional) MAC and a
+    // 32-digit hex key
+    bool add(const char *mac, const char *hexKey);
+    bool remove(const uint8_t mac[6]);
+    void clear();
+
+    // Key for devices without an entry; nullptr removes it
+    bool setDefaultKey(const uint8_t key[16]);
+
+    // Add every key in NVS namespace ns. Returns the number added.
+    size_t loadNvs(const char *ns = "bthome");
+    // Store one key in NVS namespace ns (and add it here)
+    bool saveNvs(const uint8_t mac[6], const uint8_t key[16], const char *ns = "bthome");
+    // Add "MAC KEY" lines from a file; blank lines and '#' comments are
+    // skipped. Returns the number added.
+    size_t loadFile(const char *path);
+
+    // Decrypt len bytes of cipher into plain with the key for mac
+    Result decrypt(const uint8_t mac[6], const uint8_t nonce[13],
+                   const uint8_t *cipher, size_t len, const uint8_t mic[4],
+                   uint8_t *plain);
+
+    Stats stats() const;
+    size_t size() const;
+
+private:
+    struct Entry {
+        uint64_t key;
+        mbedtls_ccm_context ctx;
+    };
+
+    static bool setup(mbedtls_ccm_context &ctx, const uint8_t key[16]);
+    size_t lowerBound(uint64_t key) const;
+
+    std::vector<std::unique_ptr<Entry>> _entries; // sorted by key
+    std::unique_ptr<Entry> _default;
+    uint32_t _hits = 0;
+    uint32_t _defaults = 0;
+    uint32_t _misses = 0;
+    uint32_t _failures = 0;
+    mutable std::mutex _lock;
+};
@@ -0,0 +1,171 @@
+/// @file hexcodec.hpp
+/// @brief Table-driven hex encoder/decoder and MAC helpers shared by the
+/// scanner and decoders.
+///
+/// Encoding writes into a caller-provided buffer: one 16-bit table load and
+/// store per input byte, no Arduino String growth and no printf. Where the
+/// target has vector registers (SSE2, NEON, RVV) blocks of 8 bytes are
+/// expanded with GCC vector extensions instead; define HEXCODEC_VECTOR to 0
+/// or 1 to override the choice. Decoding maps each character through a
+/// 256-entry table and checks validity once per byte instead of branching
+/// on character ranges.
+///
+/// Pure C++ with no platform dependencies, so it builds on the host.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifndef HEXCODEC_VECTOR
+#if defined(__GNUC__) && !defined(__clang__) && \
+    (defined(__SSE2__) || defined(__ARM_NEON) || defined(__riscv_vector))
+#define HEXCODEC_VECTOR 1
+#else
+#define HEXCODEC_VECTOR 0
+#endif
+#endif
+
+namespace hexcodec_detail {
+
+/// Two output characters per byte value, upper and lower case.
+struct EncodeTable {
+    char upper[512];
+    char lower[512];
+
+    constexpr EncodeTable() : upper(), lower() {
+        const char *U = "0123456789ABCDEF";
+        const char *L = "0123456789abcdef";
+        for (int i = 0; i < 256; i++) {
+            upper[2 * i] = U[i >> 4];
+            upper[2 * i + 1] = U[i & 15];
+            lower[2 * i] = L[i >> 4];
+            lower[2 * i + 1] = L[i & 15];
+        }
+    }
+};
+
+/// Nibble value per character, 0xFF for anything that is not a hex digit.
+struct DecodeTable {
+    uint8_t nibble[256];
+
+    constexpr DecodeTable() : nibble() {
+        for (int i = 0; i < 256; i++)
+            nibble[i] = 0xFF;
+        for (int i = 0; i < 10; i++)
+            nibble['0' + i] = i;
+        for (int i = 0; i < 6; i++) {
+            nibble['A' + i] = 10 + i;
+            nibble['a' + i] = 10 + i;
+        }
+    }
+};
+
+inline constexpr EncodeTable ENCODE{};
+inline constexpr DecodeTable DECODE{};
+
+#if HEXCODEC_VECTOR
+typedef uint8_t v16u8 __attribute__((vector_size(16)));
+typedef uint64_t v2u64 __attribute__((vector_size(16)));
+
+// 8 bytes in, 16 characters out. Both nibbles are split off with one
+// shift count for all lanes (SSE2 has no per-lane byte shift) and then
+// interleaved.
+inline void encode8(const uint8_t *in, char *out, bool lower) {
+    uint64_t bytes;
+    memcpy(&bytes, in, 8);
+    v16u8 v = (v16u8)(v2u64){bytes, 0}; // in a register, not through memory
+    v16u8 n = __builtin_shuffle(v >> 4, v & 15,
+                                (v16u8){0, 16, 1, 17, 2, 18, 3, 19,
+                                        4, 20, 5, 21, 6, 22, 7, 23});
+    const uint8_t skip = lower ? 'a' - '0' - 10 : 'A' - '0' - 10; // gap after '9'
+    v16u8 c = n + (uint8_t)'0' + ((v16u8)(n > 9) & skip);
+    memcpy(out, &c, 16);
+}
+#endif
+
+} // namespace hexcodec_detail
+
+/// Nibble value of one hex digit (either case), or -1.
+inline int hexNibble(char c) {
+    uint8_t v = hexcodec_detail::DECODE.nibble[(uint8_t)c];
+    return v == 0xFF ? -1 : v;
+}
+
+/// Encode len bytes as 2 * len hex characters followed by a NUL, so out
+/// must hold 2 * len + 1 characters. Returns the number of characters
+/// written, not counting the NUL.
+inline size_t hexEncode(const uint8_t *in, size_t len, char *out, bool lower = false) {
+    const char *table = lower ? hexcodec_detail::ENCODE.lower : hexcodec_detail::ENCODE.upper;
+    size_t i = 0;
+#if HEXCODEC_VECTOR
+    for (; i + 8 <= len; i += 8)
+        hexcodec_detail::encode8(in + i, out + 2 * i, lower);
+#endif
+    for (; i < len; i++)
+        memcpy(out + 2 * i, table + 2 * in[i], 2);
+    out[2 * len] = '\0';
+    return 2 * len;
+}
+
+/// Decode len / 2 bytes from len hex characters (either case) into out.
+/// Returns false if len is odd or any character is not a hex digit; out
+/// may have been partly written in that case.
+inline bool hexDecode(const char *in, size_t len, uint8_t *out) {
+    if (len & 1)
+        return false;
+    const uint8_t *nib = hexcodec_detail::DECODE.nibble;
+    uint8_t bad = 0;
+    for (size_t i = 0; i < len / 2; i++) {
+        uint8_t hi = nib[(uint8_t)in[2 * i]];
+        uint8_t lo = nib[(uint8_t)in[2 * i + 1]];
+        bad |= hi | lo;
+        out[i] = (uint8_t)(hi << 4) | lo;
+    }
+    return !(bad & 0xF0);
+}
+
+/// Format a MAC as uppercase hex, with sep between the bytes unless sep is
+/// '\0': out must hold 18 characters with a separator, 13 without.
+inline void hexFormatMac(const uint8_t mac[6], char *out, char sep = ':') {
+    const char *table = hexcodec_detail::ENCODE.upper;
+    for (int i = 0; i < 6; i++) {
+        memcpy(out, table + 2 * mac[i], 2);
+        out += 2;
+        if (sep && i < 5)
+            *out++ = sep;
+    }
+    *out = '\0';
+}
+
+/// Parse a MAC given as 12 hex digits (either case), optionally separated
+/// by ':' or '-' ("AA:BB:CC:DD:EE:FF", "aabbccddeeff"). Anything else,
+/// including trailing characters, is rejected.
+inline bool hexParseMac(const char *str, uint8_t mac[6]) {
+    if (!str)
+        return false;
+    int n = 0;
+    while (*str && n < 12) {
+        if (*str == ':' || *str == '-') {
+            str++;
+            continue;
+        }
+        int v = hexNibble(*str++);
+        if (v < 0)
+            return false;
+        if (n & 1)
+            mac[n / 2] = (uint8_t)((mac[n / 2] << 4) | v);
+        else
+            mac[n / 2] = (uint8_t)v;
+        n++;
+    }
+    return n == 12 && *str == '\0';
+}
+
+/// 48-bit MAC packed into an integer key, most significant byte first.
+inline uint64_t macKey(const uint8_t mac[6]) {
+    uint64_t k = 0;
+    for (int i = 0; i < 6; i++)
+        k = (k << 8) | mac[i];
+    return k;
+}
@@ -0,0 +1,52 @@
+/// @file hostport.hpp
+/// @brief The few ESP-IDF / Arduino facilities the BLE pipeline uses,
+/// provided for builds without ESP_PLATFORM.
+///
+/// Lets BLEScanner's enqueue and decode paths and the BTHome decoder build
+/// and run on a Linux host (adverts fed through BLEScanner::injectAdvert(),
+/// queues backed by HostRingBuffer) for the native tests and throughput
+/// measurements. Memory capabilities are
+/// accepted and ignored, time comes from the steady clock, and the log
+/// macros print errors, warnings and info to stderr.
+
+#pragma once
+#ifdef ESP_PLATFORM
+    #error "hostport.hpp is for builds without ESP-IDF"
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+typedef unsigned int UBaseType_t;
+
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT  (1 << 12)
+
+inline int64_t esp_timer_get_time() {
+    using namespace std::chrono;
+    static const auto start = steady_clock::now();
+    return duration_cast<microseconds>(steady_clock::now() - start).count();
+}
+
+inline void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline size_t heap_caps_get_free_size(uint32_t) {
+    return 0;
+}
+
+inline size_t heap_caps_get_minimum_free_size(uint32_t) {
+    return 0;
+}
+
+#ifndef log_e
+#define log_e(fmt, ...) fprintf(stderr, "[E] " fmt "\n", ##__VA_ARGS__)
+#define log_w(fmt, ...) fprintf(stderr, "[W] " fmt "\n", ##__VA_ARGS__)
+#define log_i(fmt, ...) fprintf(stderr, "[I] " fmt "\n", ##__VA_ARGS__)
+#define log_d(fmt, ...) do {} while (0)
+#define log_v(fmt, ...) do {} while (0)
+#endif
@@ -0,0 +1,138 @@
+#include "AdvFilter.h"
+
+#include "advrecord.hpp"
+#include "hexcodec.hpp"
+
+bool AdvFilter::allowMac(const char *mac) {
+    uint8_t m[6];
+    if (!hexParseMac(mac, m))
+        return false;
+    allowMac(m);
+    return true;
+}
+
+bool AdvFilter::denyMac(const char *mac) {
+    uint8_t m[6];
+    if (!hexParseMac(mac, m))
+        return false;
+    denyMac(m);
+    return true;
+}
+
+void AdvFilter::allowMac(const uint8_t mac[6]) {
+    _allowMac.insert(macKey(mac));
+}
+
+void AdvFilter::denyMac(const uint8_t mac[6]) {
+    _denyMac.insert(macKey(mac));
+}
+
+void AdvFilter::allowCompany(uint16_t companyId) {
+    _allowCompany.insert(companyId);
+}
+
+void AdvFilter::denyCompany(uint16_t companyId) {
+    _denyCompany.insert(companyId);
+}
+
+void AdvFilter::allowServiceUuid(uint32_t uuid) {
+    _allowUuid.insert(uuid);
+}
+
+void AdvFilter::denyServiceUuid(uint32_t uuid) {
+    _denyUuid.insert(uuid);
+}
+
+bool AdvFilter::hasAllowRules() const {
+    return !_allowMac.empty() || !_allowCompany.empty() || !_allowUuid.empty();
+}
+
+bool AdvFilter::empty() const {
+    return !hasAllowRules() &&
+           _denyMac.empty() && _denyCompany.empty() && _denyUuid.empty();
+}
+
+size_t AdvFilter::ruleCount() const {
+    return _denyMac.size() + _denyCompany.size() + _denyUuid.size() +
+           _allowMac.size() + _allowCompany.size() + _allowUuid.size();
+}
+
+size_t AdvFilter::ruleHits(RuleHits *out, size_t maxRules) const {
+    size_t n = 0;
+    auto copy = [&](const auto &set, RuleHits::Kind kind, bool allow) {
+        set.forEach([&](uint64_t key, uint32_t hits) {
+            if (n < maxRules)
+                out[n++] = {kind, allow, key, hits};
+        });
+    };
+    copy(_denyMac, RuleHits::MAC, false);
+    copy(_denyCompany, RuleHits::COMPANY, false);
+    copy(_denyUuid, RuleHits::UUID, false);
+    copy(_allowMac, RuleHits::MAC, true);
+    copy(_allowCompany, RuleHits::COMPANY, true);
+    copy(_allowUuid, RuleHits::UUID, true);
+    return n;
+}
+
+AdvFilter::Verdict AdvFilter::check(const uint8_t mac[6],
+                                    const uint8_t *ad, size_t adLen) const {
+    uint64_t key = macKey(mac);
+    if (_denyMac.hit(key))
+        return DENY_MAC;
+
+    bool allowed = _allowMac.hit(key);
+    bool needContent = !allowed ||
+                       !_denyCompany.empty() || !_denyUuid.empty();
+    if (!needContent)
+        return PASS;
+
+    Verdict verdict = PASS;
+    auto uuid = [&](uint32_t u) {
+        if (_denyUuid.hit(u))
+            verdict = DENY_UUID;
+        else if (_allowUuid.hit(u))
+            allowed = true;
+    };
+
+    forEachAD(ad, adLen, [&](uint8_t type, const uint8_t *data, size_t len) {
+        if (verdict != PASS)
+            return;
+        switch (type) {
+            case AD_TYPE_MANUFACTURER:
+                if (len >= 2) {
+                    uint16_t company = data[0] | (data[1] << 8);
+                    if (_denyCompany.hit(company))
+                        verdict = DENY_COMPANY;
+                    else if (_allowCompany.hit(company))
+                        allowed = true;
+                }
+                break;
+            case AD_TYPE_UUID16_PARTIAL:
+            case AD_TYPE_UUID16_COMPLETE:
+                for (size_t i = 0; i + 2 <= len && verdict == PASS; i += 2)
+                    uuid(data[i] | (data[i + 1] << 8));
+                break;
+            case AD_TYPE_UUID32_PARTIAL:
+            case AD_TYPE_UUID32_COMPLETE:
+                for (size_t i = 0; i + 4 <= len && verdict == PASS; i += 4)
+                    uuid(data[i] | (data[i + 1] << 8) |
+                         ((uint32_t)data[i + 2] << 16) | ((uint32_t)data[i + 3] << 24));
+                break;
+            case AD_TYPE_SERVICE_DATA16:
+                if (len >= 2)
+                    uuid(data[0] | (data[1] << 8));
+                break;
+            case AD_TYPE_SERVICE_DATA32:
+                if (len >= 4)
+                    uuid(data[0] | (data[1] << 8) |
+                         ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+                break;
+        }
+    });
+
+    if (verdict != PASS)
+        return verdict;
+    if (!allowed && hasAllowRules())
+        return NOT_ALLOWED;
+    return PASS;
+}
@@ -0,0 +1,189 @@
+/// @file AdvFilter.h
+/// @brief Compiled allow/deny rule set applied to adverts before they are queued.
+///
+/// Rules match on the device MAC, the manufacturer company ID and 16/32-bit
+/// service UUIDs (from the UUID lists and service data elements). Each rule
+/// kind is stored in an open-addressing hash set, so a check costs a single
+/// walk over the AD structures plus O(1) lookups. Every rule counts the
+/// adverts it matched (ruleHits()).
+///
+/// Evaluation order:
+///   1. a MAC, company or UUID deny rule drops the advert
+///   2. if any allow rule exists, the advert must match at least one of them
+///   3. otherwise the advert passes
+///
+/// Usage:
+/// @code
+///   AdvFilter f;
+///   f.allowCompany(0x0499);              // Ruuvi
+///   f.allowServiceUuid(0xFCD2);          // BTHome
+///   f.denyMac("AA:BB:CC:DD:EE:FF");
+///   BLEScanner::instance().setFilter(f);
+/// @endcode
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "counters.hpp"
+
+/// Open-addressing hash set of integer keys, each with a hit counter. The
+/// all-ones key is reserved as the empty marker, which no 48-bit MAC,
+/// company ID or short UUID can take.
+template <typename K>
+class FlatSet {
+public:
+    void insert(K key) {
+        if ((_count + 1) * 2 > _slots.size())
+            rehash(_slots.empty() ? 8 : _slots.size() * 2);
+        if (place(_slots, key))
+            _count++;
+    }
+
+    bool contains(K key) const {
+        return find(key) != nullptr;
+    }
+
+    /// contains(), counting a hit against the key if present. Single writer:
+    /// one caller at a time (see counters.hpp).
+    bool hit(K key) const {
+        const Slot *s = find(key);
+        if (!s)
+            return false;
+        bump(s->hits);
+        return true;
+    }
+
+    /// Call f(key, hits) for every key.
+    template <typename F>
+    void forEach(F &&f) const {
+        for (const Slot &s : _slots)
+            if (s.key != EMPTY)
+                f(s.key, peek(s.hits));
+    }
+
+    size_t size() const {
+        return _count;
+    }
+
+    bool empty() const {
+        return _count == 0;
+    }
+
+private:
+    static constexpr K EMPTY = (K)~(K)0;
+
+    // Copies carry the count along, so the set stays copyable.
+    struct Slot {
+        K key = EMPTY;
+        mutable Counter hits{0};
+
+        Slot() = default;
+        Slot(const Slot &o) : key(o.key), hits(peek(o.hits)) {}
+        Slot &operator=(const Slot &o) {
+            key = o.key;
+            hits.store(peek(o.hits), std::memory_order_relaxed);
+            return *this;
+        }
+    };
+
+    std::vector<Slot> _slots;
+    size_t _count = 0;
+
+    const Slot *find(K key) const {
+        if (_count == 0)
+            return nullptr;
+        size_t mask = _slots.size() - 1;
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+            if (_slots[i].key == key)
+                return &_slots[i];
+            if (_slots[i].key == EMPTY)
+                return nullptr;
+        }
+    }
+
+    static size_t hash(K key) {
+        uint64_t h = (uint64_t)key * 0x9E3779B97F4A7C15ull;
+        return (size_t)(h >> 32);
+    }
+
+    static Slot *place(std::vector<Slot> &slots, K key) {
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+            if (slots[i].key == key)
+                return nullptr;
+            if (slots[i].key == EMPTY) {
+                slots[i].key = key;
+                return &slots[i];
+            }
+        }
+    }
+
+    void rehash(size_t n) {
+        std::vector<Slot> slots(n);
+        for (const Slot &s : _slots)
+            if (s.key != EMPTY)
+                *place(slots, s.key) = s;
+        _slots.swap(slots);
+    }
+};
+
+class AdvFilter {
+public:
+    /// Outcome of check(); everything but PASS drops the advert.
+    enum Verdict : uint8_t {
+        PASS = 0,
+        DENY_MAC,
+        DENY_COMPANY,
+        DENY_UUID,
+        NOT_ALLOWED, ///< allow rules exist and none matched
+        VERDICT_COUNT
+    };
+
+    /// MACs are accepted as "AA:BB:CC:DD:EE:FF" or "AABBCCDDEEFF".
+    /// Returns false (and adds nothing) if the string does not parse.
+    bool allowMac(const char *mac);
+    bool denyMac(const char *mac);
+    void allowMac(const uint8_t mac[6]);
+    void denyMac(const uint8_t mac[6]);
+
+    void allowCompany(uint16_t companyId);
+    void denyCompany(uint16_t companyId);
+
+    /// 16- or 32-bit service UUID, matched against the UUID list and
+    /// service data AD elements.
+    void allowServiceUuid(uint32_t uuid);
+    void denyServiceUuid(uint32_t uuid);
+
+    /// True if no rule has been added; such a filter passes everything.
+    bool empty() const;
+
+    /// Classify one advert given its address and raw AD structures. Counts
+    /// a hit against every rule it matches, so call it from one task at a
+    /// time; ruleHits() may run concurrently.
+    Verdict check(const uint8_t mac[6], const uint8_t *ad, size_t adLen) const;
+
+    /// One rule and the number of adverts it matched.
+    struct RuleHits {
+        enum Kind : uint8_t { MAC, COMPANY, UUID };
+        Kind kind;
+        bool allow;
+        uint64_t key;  ///< macKey() of the MAC, the company ID or the UUID
+        uint32_t hits;
+    };
+
+    /// Number of rules added.
+    size_t ruleCount() const;
+
+    /// Copy up to maxRules rules with their hit counts to out, deny rules
+    /// first. Returns the number copied.
+    size_t ruleHits(RuleHits *out, size_t maxRules) const;
+
+private:
+    FlatSet<uint64_t> _allowMac, _denyMac;
+    FlatSet<uint32_t> _allowCompany, _denyCompany;
+    FlatSet<uint32_t> _allowUuid, _denyUuid;
+
+    bool hasAllowRules() const;
+};
@@ -1,26 +1,47 @@
 #include "BLEScanner.h"
 
-#include <Arduino.h>
-#include <vector>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
-#include "freertos/ringbuf.h"
-#include "ringbuffer.hpp"
-#include "esp_timer.h"
-
-#include <BLEDevice.h>
-#include <BLEScan.h>
-#include <BLEAdvertisedDevice.h>
-
+#ifdef ESP_PLATFORM
+    #include <Arduino.h>
+    #include "freertos/ringbuf.h"
+    #include "ringbuffer.hpp"
+#else
+    #include "hostqueue.hpp"
+#endif
+#include "spscqueue.hpp"
+#include "advrecord.hpp"
+#include "AdvFilter.h"
+#include "DedupCache.h"
+#include "CoalesceTable.h"
+#include "DeviceTable.h"
+#include "ScanMerge.h"
+#include "counters.hpp"
+#include "latency.hpp"
+#include "measurement.hpp"
+#include "decoderregistry.hpp"
+#include "hexcodec.hpp"
+
+#ifdef ESP_PLATFORM
+    #include "esp_heap_caps.h"
+    #include "esp_timer.h"
+    #include "esp_pthread.h"
+
+    #include "esp_gap_ble_api.h"
+
+    #include <BLEDevice.h>
+    #include <BLEScan.h>
+    #include <BLEAdvertisedDevice.h>
+#endif
 #include "BTHomeDecoder.h"
 
-// ---------------------------------------------------------------------------
-// Timing helper (replaces fmicro.h dependency)
-// ---------------------------------------------------------------------------
-static inline float fseconds() {
-    return ((float)esp_timer_get_time()) * 1.0e-6f;
-}
-
 // ---------------------------------------------------------------------------
 // Rounding helpers
 // ---------------------------------------------------------------------------
@@ -38,45 +59,45 @@ static constexpr float k0 = 273.15f;
 // ---------------------------------------------------------------------------
 // Byte helpers
 // ---------------------------------------------------------------------------
-static inline int16_t getInt16LE(const std::vector<uint8_t> &data, int index) {
+static inline int16_t getInt16LE(const ByteView &data, int index) {
     return (int16_t)((data[index]) | (data[index + 1] << 8));
 }
 
-static inline int32_t getInt32LE(const std::vector<uint8_t> &data, int index) {
+static inline int32_t getInt32LE(const ByteView &data, int index) {
     return (int32_t)((data[index]) |
                      (data[index + 1] << 8) |
                      (data[index + 2] << 16) |
                      (data[index + 3] << 24));
 }
 
-static inline uint16_t getUint16LE(const std::vector<uint8_t> &data, int index) {
+static inline uint16_t getUint16LE(const ByteView &data, int index) {
     return (uint16_t)((data[index]) | (data[index + 1] << 8));
 }
 
-static inline int16_t getInt16BE(const std::vector<uint8_t> &data, int index) {
+static inline int16_t getInt16BE(const ByteView &data, int index) {
     return (int16_t)(((uint16_t)data[index] << 8) | (uint16_t)data[index + 1]);
 }
 
-static inline uint16_t getUint16BE(const std::vector<uint8_t> &data, int index) {
+static inline uint16_t getUint16BE(const ByteView &data, int index) {
     return (uint16_t)(((uint16_t)data[index] << 8) | (uint16_t)data[index + 1]);
 }
 
-static inline uint32_t getUint32LE(const std::vector<uint8_t> &data, int index) {
+static inline uint32_t getUint32LE(const ByteView &data, int index) {
     return (uint32_t)((data[index]) |
                       (data[index + 1] << 8) |
                       (data[index + 2] << 16) |
                       (data[index + 3] << 24));
 }
 
-static inline int8_t getInt8(const std::vector<uint8_t> &data, int index) {
+static inline int8_t getInt8(const ByteView &data, int index) {
     return (int8_t)data[index];
 }
 
-static inline uint8_t getUint8(const std::vector<uint8_t> &data, int index) {
+static inline uint8_t getUint8(const ByteView &data, int index) {
     return data[index];
 }
 
-static inline float convert_8_8_to_float(const std::vector<uint8_t> &data, int index) {
+static inline float convert_8_8_to_float(const ByteView &data, int index) {
     // 8.8 to float converter
     auto frac = getUint8(data, index);
     auto base = getUint8(data, index+1);
@@ -88,84 +109,196 @@ static inline float convert_8_8_to_float(const std::vector<uint8_t> &data, int i
 }
 
 // ---------------------------------------------------------------------------
-// Hex conversion helpers
+// Output formatting helpers
 // ---------------------------------------------------------------------------
-static bool hexStringToVector(const String &hexStr, std::vector<uint8_t> &buffer) {
-    size_t len = hexStr.length();
-    if (len & 1)
-        return false;
-
-    buffer.clear();
-    if (len == 0)
-        return true;
-
-    buffer.resize(len / 2);
-    uint8_t *out = buffer.data();
-    const char *in = hexStr.c_str();
-
-    for (size_t i = 0; i < len; i += 2) {
-        uint8_t val = 0;
-        for (int j = 0; j < 2; j++) {
-            uint8_t nibble;
-            char c = in[i + j];
-            if (c >= '0' && c <= '9')
-                nibble = c - '0';
-            else if (c >= 'A' && c <= 'F')
-                nibble = c - 'A' + 10;
-            else if (c >= 'a' && c <= 'f')
-                nibble = c - 'a' + 10;
-            else {
-                buffer.clear();
-                return false;
+// One AD element carries at most 254 data bytes
+static constexpr size_t AD_HEX_LEN = 2 * 255 + 1;
+
+static void uuidToString(const uint8_t *le, size_t len, char *out, size_t outLen) {
+    // UUIDs are little-endian on air, printed big-endian
+    uint8_t be[16];
+    for (size_t i = 0; i < len && i < sizeof(be); i++)
+        be[i] = le[len - 1 - i];
+    switch (len) {
+        case 2:
+        case 4: {
+                static const char BASE[] = "-0000-1000-8000-00805f9b34fb";
+                if (outLen < 8 + sizeof(BASE))
+                    break;
+                if (len == 2)
+                    memcpy(out, "0000", 4);
+                hexEncode(be, len, out + 8 - 2 * len, true);
+                memcpy(out + 8, BASE, sizeof(BASE));
+                return;
+            }
+        case 16: {
+                if (outLen < 37)
+                    break;
+                static const uint8_t GROUPS[] = {4, 2, 2, 2, 6};
+                char *p = out;
+                const uint8_t *b = be;
+                for (uint8_t g : GROUPS) {
+                    if (p != out)
+                        *p++ = '-';
+                    p += hexEncode(b, g, p, true);
+                    b += g;
+                }
+                return;
             }
-            val = (val << 4) | nibble;
-        }
-        *out++ = val;
-    }
-    return true;
-}
-
-static void bytesToHexString(const uint8_t *data, size_t len, String &hexStr) {
-    static const char HEX_CHARS[] = "0123456789ABCDEF";
-    hexStr = "";
-    if (len == 0)
-        return;
-    hexStr.reserve(len * 2);
-    for (size_t i = 0; i < len; i++) {
-        hexStr += HEX_CHARS[data[i] >> 4];
-        hexStr += HEX_CHARS[data[i] & 0x0F];
     }
+    if (outLen)
+        out[0] = '\0';
 }
 
-static bool stringToHexString(const std::string &str, String &hexStr) {
-    bytesToHexString((const uint8_t *)str.data(), str.length(), hexStr);
-    return true;
-}
-
-// Non-static — also used by BTHomeDecoder.cpp
-bool stringToHexString(const String &str, String &hexStr) {
-    bytesToHexString((const uint8_t *)str.c_str(), str.length(), hexStr);
-    return true;
+static void formatMac(const uint8_t mac[6], char *out, size_t outLen) {
+    if (outLen >= 18)
+        hexFormatMac(mac, out);
+    else if (outLen)
+        out[0] = '\0';
 }
 
 // ---------------------------------------------------------------------------
 // BLEScanner::Impl — hidden state
 // ---------------------------------------------------------------------------
+
+// The input queues of one consumer, one per priority lane. Without a low
+// lane everything goes to the high lane.
+struct LaneQueues {
+    ItemQueue *lane[BLEScanner::LANE_COUNT] = {};
+
+    ItemQueue *forLane(BLEScanner::Lane l) const {
+        ItemQueue *q = lane[(size_t)l];
+        return q ? q : lane[(size_t)BLEScanner::Lane::High];
+    }
+};
+
+// One decode worker: its own input queues (adverts are sharded by MAC so a
+// device always lands on the same worker) and counters only it writes.
+struct DecodeWorker {
+    LaneQueues queues;
+    std::thread thread;
+    int64_t startUs = 0;
+    CounterSeq seq;
+    std::atomic<uint64_t> busyUs{0};
+    Counter processed{0};
+    Counter decoded{0};
+    Counter outputDrops{0};
+};
+
+// Counters written on the enqueue side: by the scan callback, or by the
+// merge expiry timer while it holds mergeLock, so one writer at a time.
+// seq also covers the ScanMerge counters, which are written by the same
+// two callers.
+struct ProducerCounters {
+    CounterSeq seq;
+    Counter queueFull{0};
+    Counter acquireFail{0};
+    Counter filtered[AdvFilter::VERDICT_COUNT] = {};
+    Counter suppressed{0};
+    Counter reemitted{0};
+    Counter evicted{0};
+    Counter coalesced{0};
+    Counter coalesceFull{0};
+    Counter laneQueued[BLEScanner::LANE_COUNT] = {};
+    Counter laneDropped[BLEScanner::LANE_COUNT] = {};
+    Counter occupancy[BLEScanner::OCCUPANCY_BUCKETS] = {};
+};
+
+// Counters written by process() / processBatch() on the loop task.
+struct ConsumerCounters {
+    CounterSeq seq;
+    Counter received{0};
+    Counter decoded{0};
+};
+
+// Output queue item: OutputHeader followed by NUL-terminated JSON.
+static constexpr size_t OUTPUT_MAC_LEN = 13;
+
+struct OutputHeader {
+    uint64_t timeUs;          // scan callback
+    int64_t decodedUs;        // decode done
+    char mac[OUTPUT_MAC_LEN]; // NUL-terminated
+};
+
 struct BLEScanner::Impl {
-    espidf::RingBuffer *queue = nullptr;
+    LaneQueues queues;                     // loop-driven mode (no workers)
+    DecodeWorker *workers = nullptr;
+    ItemQueue *output = nullptr;           // worker results for drainOutput()
+    uint8_t workerCount = 0;
+    int workerCore = -1;
+    uint32_t workerStackSize = 6144;
+    UBaseType_t workerPriority = 1;
+#ifdef ESP_PLATFORM
     BLEScan *pBLEScan = nullptr;
+#endif
     BTHomeDecoder bthDecoder;
-    const char *bthKey = "";
+    BTHomeKeyStore bthKeys;                // per-device keys and the default key
 
     uint32_t scanTimeMs = 15000;
     uint16_t scanInterval = 100;
     uint16_t scanWindow = 99;
     bool activeScan = false;
-
-    uint32_t queueFull = 0;
-    uint32_t acquireFail = 0;
-    uint32_t received = 0;
-    uint32_t decoded = 0;
+    bool continuousScan = false;
+
+    // Active scan: hold adverts briefly to join them with their scan
+    // response. mergeLock serializes the scan callback with the expiry
+    // timer, which both feed the (single producer) queues.
+    uint32_t mergeTimeoutMs = 100;
+    size_t mergeSlots = 16;
+    ScanMerge merge;
+    std::mutex mergeLock;
+#ifdef ESP_PLATFORM
+    esp_timer_handle_t mergeTimer = nullptr;
+#endif
+    std::atomic<bool> scanning{false};     // cleared by the scan complete callback
+
+    // Active filter; nullptr passes everything. filterUsers counts the
+    // FilterRef holders (admitRecord() on the scan callback or merge expiry
+    // timer, filterHits()) per filter generation (its low bit), so
+    // setFilter() waits only for those that may still hold the previous
+    // rule set.
+    std::atomic<const AdvFilter *> filter{nullptr};
+    std::atomic<uint32_t> filterGen{0};
+    std::atomic<uint32_t> filterUsers[2] = {};
+
+    uint32_t dedupWindowMs = 0;
+    uint32_t dedupReemitMs = 30000;
+    size_t dedupEntries = 256;
+    DedupCache dedup;
+
+    OverloadPolicy overloadPolicy = OverloadPolicy::DropNewest;
+    size_t coalesceSlots = 64;
+    CoalesceTable coalesce;
+
+    size_t deviceCapacity = 0;
+    UBaseType_t deviceCaps = MALLOC_CAP_SPIRAM;
+    DeviceTable devices;
+    MeasurementSink *sink = nullptr;
+
+    size_t lowLaneSize = 0;
+    size_t fastTierSize = 2048;
+#ifdef ESP_PLATFORM
+    std::vector<espidf::TieredRingBuffer *> tiered; // for spill statistics
+#endif
+    bool rawUnknown = true;                // publish undecoded adverts individually
+
+    ProducerCounters producer;
+    ConsumerCounters consumer;
+    LatencyHistogram latency[BLEScanner::STAGE_COUNT];
+    uint32_t traceEvery = 0;
+    uint32_t traceCountdown = 0;           // producer
+    uint32_t traceSeq = 0;                 // producer
+    Counter scanStarts{0};                 // scan task
+    int64_t lastResultUs = 0;
+    Counter maxGapUs{0};                   // scan callback, outside mergeLock
+
+    /// Queues of the consumer adverts from this device go to.
+    LaneQueues *queuesFor(const uint8_t mac[6]) {
+        if (!workerCount)
+            return &queues;
+        uint32_t h = (uint32_t)((macKey(mac) * 0x9E3779B97F4A7C15ull) >> 32);
+        return &workers[h % workerCount].queues;
+    }
 };
 
 // Singleton storage — the Impl pointer lives on the single instance.
@@ -186,318 +319,704 @@ static uint8_t volt2percent(float v) {
 // ---------------------------------------------------------------------------
 // Decoders (file-static)
 // ---------------------------------------------------------------------------
-static bool decodeRuuvi(const std::vector<uint8_t> &data, JsonDocument &json) {
+#ifndef BLE_NO_RUUVI
+static bool decodeRuuvi(const ByteView &data, Measurement &m) {
     if (data.size() < 20)
         return false;
     if (data[2] != 5)
         return false;
 
-    json["dev"] = "Ruuvi";
+    m.dev = "Ruuvi";
 
     int16_t tempRaw = getInt16BE(data, 3);
     if (tempRaw != (int16_t)0x8000)
-        json["temp"] = tempRaw * 0.005;
+        m.addDouble("temp", tempRaw * 0.005);
 
     uint16_t humidityRaw = getUint16BE(data, 5);
     if (humidityRaw != 0xFFFF)
-        json["hum"] = humidityRaw * 0.0025;
+        m.addDouble("hum", humidityRaw * 0.0025);
 
     uint16_t pressureRaw = getUint16BE(data, 7);
     if (pressureRaw != 0xFFFF)
-        json["press"] = (pressureRaw + 50000.0) / 100.0;
+        m.addDouble("press", (pressureRaw + 50000.0) / 100.0);
 
     int16_t accX = getInt16BE(data, 9);
     int16_t accY = getInt16BE(data, 11);
     int16_t accZ = getInt16BE(data, 13);
-    if (accX != (int16_t)0x8000) json["accx"] = accX;
-    if (accY != (int16_t)0x8000) json["accy"] = accY;
-    if (accZ != (int16_t)0x8000) json["accz"] = accZ;
+    if (accX != (int16_t)0x8000) m.addInt("accx", accX);
+    if (accY != (int16_t)0x8000) m.addInt("accy", accY);
+    if (accZ != (int16_t)0x8000) m.addInt("accz", accZ);
 
     uint16_t powerInfo = getUint16BE(data, 15);
     uint16_t batteryRaw = (powerInfo >> 5);
     if (batteryRaw != 2047) {
         float volt = (batteryRaw + 1600) / 1000.0f;
-        json["bat"] = volt;
-        json["batpct"] = volt2percent(volt);
+        m.addFloat("bat", volt);
+        m.addUint("batpct", volt2percent(volt));
     }
 
     uint8_t txpRaw = powerInfo & 0x1F;
     if (txpRaw != 31)
-        json["txpwr"] = (txpRaw * 2) - 40;
+        m.addInt("txpwr", (txpRaw * 2) - 40);
 
     if (data[17] != 255)
-        json["move"] = data[17];
+        m.addUint("move", data[17]);
 
     uint16_t sequenceNumber = getUint16BE(data, 18);
     if (sequenceNumber != 0xFFFF)
-        json["seq"] = sequenceNumber;
+        m.addUint("seq", sequenceNumber);
 
     return true;
 }
+#endif
 
-static bool decodeMopeka(const std::vector<uint8_t> &data, JsonDocument &json) {
+#ifndef BLE_NO_MOPEKA
+static bool decodeMopeka(const ByteView &data, Measurement &m) {
     if (data.size() != 12)
         return false;
 
-    json["dev"] = "Mopeka";
-    json["type"] = data[2];
+    m.dev = "Mopeka";
+    m.addUint("type", data[2]);
     float volt = (data[3] & 0x7f) / 32.0f;
-    json["bat"] = volt;
-    json["batpct"] = volt2percent(volt);
-    json["sync"] = (data[4] & 0x80) > 0;
+    m.addFloat("bat", volt);
+    m.addUint("batpct", volt2percent(volt));
+    m.addBool("sync", (data[4] & 0x80) > 0);
     float raw_temp = (data[4] & 0x7f);
-    json["temp"] = raw_temp - 40.0f;
-    json["quality"] = (data[6] >> 6);
-    json["accx"] = data[10];
-    json["accy"] = data[11];
+    m.addFloat("temp", raw_temp - 40.0f);
+    m.addUint("quality", data[6] >> 6);
+    m.addUint("accx", data[10]);
+    m.addUint("accy", data[11]);
     float raw_level = ((int(data[6]) << 8) + data[5]) & 0x3fff;
 
-    json["lvl_raw"] = raw_level;
-    json["lvl_prop"] = round1(raw_level *
-                              (MOPEKA_TANK_LEVEL_COEFFICIENTS_PROPANE_0 +
-                               (MOPEKA_TANK_LEVEL_COEFFICIENTS_PROPANE_1 * raw_temp) +
-                               (MOPEKA_TANK_LEVEL_COEFFICIENTS_PROPANE_2 * raw_temp *
-                                raw_temp)));
+    m.addFloat("lvl_raw", raw_level);
+    m.addDouble("lvl_prop", round1(raw_level *
+                                  (MOPEKA_TANK_LEVEL_COEFFICIENTS_PROPANE_0 +
+                                   (MOPEKA_TANK_LEVEL_COEFFICIENTS_PROPANE_1 * raw_temp) +
+                                   (MOPEKA_TANK_LEVEL_COEFFICIENTS_PROPANE_2 * raw_temp *
+                                    raw_temp))));
     return true;
 }
+#endif
 
-static bool decodeTPMS100(const std::vector<uint8_t> &data, JsonDocument &json) {
+#ifndef BLE_NO_TPMS
+static bool decodeTPMS100(const ByteView &data, Measurement &m) {
     if (data.size() != 18)
         return false;
 
-    json["dev"] = "TPMS0100";
-    json["loc"] = data[2] & 0x7f;
-    json["press"] = (float)getInt32LE(data, 8) / 100000.0f;
-    json["temp"] = (float)getInt32LE(data, 12) / 100.0f;
-    json["batpct"] = data[16];
-    json["status"] = data[17];
+    m.dev = "TPMS0100";
+    m.addUint("loc", data[2] & 0x7f);
+    m.addFloat("press", (float)getInt32LE(data, 8) / 100000.0f);
+    m.addFloat("temp", (float)getInt32LE(data, 12) / 100.0f);
+    m.addUint("batpct", data[16]);
+    m.addUint("status", data[17]);
     return true;
 }
 
-static bool decodeTPMS00AC(const std::vector<uint8_t> &data, JsonDocument &json) {
+static bool decodeTPMS00AC(const ByteView &data, Measurement &m) {
     if (data.size() != 15)
         return false;
 
-    json["dev"] = "TPMS00AC";
-    json["loc"] = data[6] & 0x7f;
-    json["press"] = (float)getInt32LE(data, 0);
-    json["temp"] = k0 + getInt32LE(data, 4) / 100.0f;
-    json["batpct"] = data[5];
-    json["status"] = 0;
+    m.dev = "TPMS00AC";
+    m.addUint("loc", data[6] & 0x7f);
+    m.addFloat("press", (float)getInt32LE(data, 0));
+    m.addFloat("temp", k0 + getInt32LE(data, 4) / 100.0f);
+    m.addUint("batpct", data[5]);
+    m.addUint("status", 0);
     return true;
 }
+#endif
 
-static bool decodeOtodata(const std::vector<uint8_t> &data, JsonDocument &json) {
+#ifndef BLE_NO_OTODATA
+static bool decodeOtodata(const ByteView &data, Measurement &m) {
     switch (data.size()) {
         case 21:
-            json["dev"] = "Otodata";
-            json["level"] = ((float)getUint16LE(data, 11)) / 100.0f;
-            json["status"] = getUint16LE(data, 13);
+            m.dev = "Otodata";
+            m.addFloat("level", ((float)getUint16LE(data, 11)) / 100.0f);
+            m.addUint("status", getUint16LE(data, 13));
+            break;
+        case 24:
+            m.dev = "Otodata";
+            m.addUintText("serial", getUint32LE(data, 9));
+            m.addUintText("model", getUint16LE(data, 21));
             break;
-        case 24: {
-                json["dev"] = "Otodata";
-                char buffer[12];
-                utoa(getUint32LE(data, 9), buffer, 10);
-                json["serial"] = buffer;
-                utoa(getUint16LE(data, 21), buffer, 10);
-                json["model"] = buffer;
-                break;
-            }
         default:
             return false;
     }
     return true;
 }
+#endif
 
-static bool decodeRotarexELG(const std::vector<uint8_t> &data, JsonDocument &json,
-                             JsonObject BLEdata) {
+#ifndef BLE_NO_ROTAREX
+static bool decodeRotarexELG(const ByteView &data, Measurement &m) {
     if (data.size() != 12)
         return false;
 
-    json["dev"] = "Rotarex";
+    m.dev = "Rotarex";
     int16_t level = getInt16LE(data, 8) / 10.0f;
 
     switch (level) {
         case -32768:
-            json["status"] = "no sensor";
-            json["level"] = 0.0;
+            m.addText("status", "no sensor");
+            m.addDouble("level", 0.0);
             break;
         case 10000:
-            json["status"] = "full";
-            json["level"] = level / 100.0f;
+            m.addText("status", "full");
+            m.addFloat("level", level / 100.0f);
             break;
         default:
-            json["level"] = level;
-            json["status"] = "OK";
+            m.addInt("level", level);
+            m.addText("status", "OK");
     }
     float volt = getInt16LE(data, 10) / 1000.0f;
-    json["bat"] = volt;
-    json["batpct"] = volt2percent(volt);
-    json["connectable"] = BLEdata["connectable"];
+    m.addFloat("bat", volt);
+    m.addUint("batpct", volt2percent(volt));
     return true;
 }
+#endif
 
+#ifndef BLE_NO_MIKROTIK
 // assumes Mikrotik advertisements, no encryption
-static bool decodeMikrotik(const std::vector<uint8_t> &data, JsonDocument &json) {
+static bool decodeMikrotik(const ByteView &data, Measurement &m) {
     if (data.size() != 20)
         return false;
     int16_t t = getInt16LE(data, 12);
     if (t != -32768) { // 0x8000 -> temp is unsupported (indoor)
-        json["dev"] = "Mikrotik TG-BT5-OUT";
-        json["tempc"] = t / 256.0;
+        m.dev = "Mikrotik TG-BT5-OUT";
+        m.addDouble("tempc", t / 256.0);
     } else {
-        json["dev"] = "Mikrotik TG-BT5-IN";
+        m.dev = "Mikrotik TG-BT5-IN";
     }
-    json["version"] = getUint8(data, 2);
+    m.addUint("version", getUint8(data, 2));
     auto user = getUint8(data, 3);
     if (user & 0x01) {
-        json["encrypted"] = true;
+        m.addBool("encrypted", true);
     } else {
-        json["salt"] = getUint16LE(data, 4);;
-        json["accx"] = convert_8_8_to_float(data, 6);
-        json["accy"] = convert_8_8_to_float(data, 8);
-        json["accz"] = convert_8_8_to_float(data, 10);
+        m.addUint("salt", getUint16LE(data, 4));
+        m.addFloat("accx", convert_8_8_to_float(data, 6));
+        m.addFloat("accy", convert_8_8_to_float(data, 8));
+        m.addFloat("accz", convert_8_8_to_float(data, 10));
 
         // uptime (4 bytes, little-endian)
-        json["uptime"] = getUint32LE(data, 14);
+        m.addUint("uptime", getUint32LE(data, 14));
 
         // flags (1 byte)
         uint8_t flags = getUint8(data, 18);
         if (flags & 1) {
-            json["reed_switch"] = true;
+            m.addBool("reed_switch", true);
         }
         if (flags & 2) {
-            json["accel_tilt"] = true;
+            m.addBool("accel_tilt", true);
         }
         if (flags & 4) {
-            json["accel_drop"] = true;
+            m.addBool("accel_drop", true);
         }
         if (flags & 8) {
-            json["impact_x"] = true;
+            m.addBool("impact_x", true);
         }
         if (flags & 16) {
-            json["impact_y"] = true;
+            m.addBool("impact_y", true);
         }
         if (flags & 32) {
-            json["impact_z"] = true;
+            m.addBool("impact_z", true);
         }
         // battery (1 byte)
         uint8_t batt = getUint8(data, 19);
-        json["batt"] = batt;
+        m.addUint("batt", batt);
     }
     return true;
 }
+#endif
+
+#ifndef BLE_NO_BTHOME
+#define BLE_HAVE_BTHOME
+static bool decodeBTHome(BLEScanner::Impl *impl, const AdvView &adv,
+                         const AdServiceData &sd, Measurement &m) {
+    BTHomeMeasurement objs[MEASUREMENT_MAX_FIELDS];
+    BTHomeDecodeStatus st = impl->bthDecoder.parseBTHomeV2(
+                                sd.data.data(), sd.data.size(), adv.rec->mac,
+                                nullptr, objs, MEASUREMENT_MAX_FIELDS);
+
+    if (st.isBTHome && st.decryptionSucceeded) {
+        m.flags |= MEASUREMENT_BTHOME;
+        m.version = st.bthomeVersion;
+        size_t n = st.count < MEASUREMENT_MAX_FIELDS ? st.count : MEASUREMENT_MAX_FIELDS;
+        for (size_t i = 0; i < n; i++)
+            m.addObject(objs[i].objectID, objs[i].object->name, objs[i].object->unit,
+                        objs[i].value);
+        size_t dropped = st.count - n;
+        m.dropped = dropped < UINT8_MAX ? (uint8_t)dropped : UINT8_MAX;
+        return true;
+    }
+    return false;
+}
+#endif
 
-static bool decodeBTHome(JsonObject BLEdata, JsonDocument &json,
-                         BTHomeDecoder &decoder, const char *key) {
-    std::vector<uint8_t> sd;
-    if (!hexStringToVector(BLEdata["sd"], sd))
-        return false;
+// ---------------------------------------------------------------------------
+// Decoder registry
+// ---------------------------------------------------------------------------
+// Decoders are found by company ID (manufacturer data) or 16-bit service
+// data UUID in constexpr tables kept sorted by ID (checked at compile time)
+// and binary searched, see decoderregistry.hpp. Each table starts with
+// {0, nullptr} so it is never empty when every decoder is compiled out;
+// ID 0 then means no decoder.
+// Build with -DBLE_NO_<NAME> (RUUVI, MOPEKA, TPMS, OTODATA, ROTAREX,
+// MIKROTIK, BTHOME) to leave a decoder out. Add a decoder by adding its
+// entry here.
+using MfdDecoder = bool (*)(const ByteView &data, Measurement &m);
+using ServiceDecoder = bool (*)(BLEScanner::Impl *impl, const AdvView &adv,
+                                const AdServiceData &sd, Measurement &m);
+
+static constexpr DecoderEntry<MfdDecoder> MFD_DECODERS[] = {
+    {0x0000, nullptr},
+#ifndef BLE_NO_MOPEKA
+    {0x0059, decodeMopeka},
+#endif
+#ifndef BLE_NO_TPMS
+    {0x00AC, decodeTPMS00AC},
+    {0x0100, decodeTPMS100},
+#endif
+#ifndef BLE_NO_OTODATA
+    {0x03B1, decodeOtodata},
+#endif
+#ifndef BLE_NO_RUUVI
+    {0x0499, decodeRuuvi},
+#endif
+#ifndef BLE_NO_MIKROTIK
+    {0x094F, decodeMikrotik},
+#endif
+#ifndef BLE_NO_ROTAREX
+    {0xFFFF, decodeRotarexELG},
+#endif
+};
 
-    BTHomeDecodeResult bthRes = decoder.parseBTHomeV2(
-                                    std::string(sd.begin(), sd.end()),
-                                    BLEdata["mac"],
-                                    key);
+static constexpr DecoderEntry<ServiceDecoder> SERVICE_DECODERS[] = {
+    {0x0000, nullptr},
+#ifdef BLE_HAVE_BTHOME
+    {0xFCD2, decodeBTHome},
+#endif
+};
 
-    if (bthRes.isBTHome && bthRes.decryptionSucceeded) {
-        JsonObject root = json.to<JsonObject>();
-        root["bthome_version"] = bthRes.bthomeVersion;
-        JsonArray measArr = root["measurements"].to<JsonArray>();
+static_assert(sortedById(MFD_DECODERS), "MFD_DECODERS must be sorted by company ID");
+static_assert(sortedById(SERVICE_DECODERS), "SERVICE_DECODERS must be sorted by UUID");
 
-        for (auto &m : bthRes.measurements) {
-            JsonObject obj = measArr.add<JsonObject>();
-            obj["object_id"] = m.objectID;
-            obj["name"]      = m.name;
-            obj["value"]     = m.value;
-            obj["unit"]      = m.unit;
-        }
-        return true;
+static MfdDecoder mfdDecoderFor(uint16_t companyId) {
+    return findDecoder(MFD_DECODERS, companyId);
+}
+
+static ServiceDecoder serviceDecoderFor(uint16_t uuid) {
+    return findDecoder(SERVICE_DECODERS, uuid);
+}
+
+// True if deliver() has a decoder for this advert's company ID or service
+// data UUID; decides the queue lane.
+static bool hasDecoder(const uint8_t *ad, size_t len) {
+    for (AdElement e : AdParser(ad, len)) {
+        const ByteView &d = e.data;
+        if (e.type == AD_TYPE_MANUFACTURER && d.size() >= 2 &&
+                mfdDecoderFor(d[1] << 8 | d[0]))
+            return true;
+        if (e.type == AD_TYPE_SERVICE_DATA16 && d.size() >= 2 &&
+                serviceDecoderFor(d[1] << 8 | d[0]))
+            return true;
     }
     return false;
 }
 
 // ---------------------------------------------------------------------------
-// BLE scan callback — enqueues raw advertisement data as MsgPack
+// Enqueue / dequeue with the configured overload policy
 // ---------------------------------------------------------------------------
-class ScanCallback : public BLEAdvertisedDeviceCallbacks {
-    void onResult(BLEAdvertisedDevice advertisedDevice) override {
-        if (!s_impl || !s_impl->queue)
-            return;
 
-        JsonDocument doc;
-        JsonObject BLEdata = doc.to<JsonObject>();
-
-        String mac = advertisedDevice.getAddress().toString();
-        mac.toUpperCase();
-        BLEdata["mac"] = (char *)mac.c_str();
-        BLEdata["rssi"] = (int)advertisedDevice.getRSSI();
+// After each send: update the high water mark and count the fill level in
+// the occupancy histogram.
+static void sampleOccupancy(BLEScanner::Impl *impl, ItemQueue *queue) {
+    size_t used = queue->update_high_watermark();
+    size_t total = queue->get_total_size();
+    size_t bucket = total ? used * BLEScanner::OCCUPANCY_BUCKETS / total : 0;
+    if (bucket >= BLEScanner::OCCUPANCY_BUCKETS)
+        bucket = BLEScanner::OCCUPANCY_BUCKETS - 1;
+    bump(impl->producer.occupancy[bucket]);
+}
 
-        if (advertisedDevice.haveName())
-            BLEdata["name"] = (char *)advertisedDevice.getName().c_str();
+static bool pushRecord(BLEScanner::Impl *impl, ItemQueue *queue,
+                       const AdvRecord &hdr, const uint8_t *ad) {
+    if (impl->overloadPolicy == BLEScanner::OverloadPolicy::CoalesceByMac) {
+        uint16_t index;
+        switch (impl->coalesce.put(hdr, ad, &index)) {
+            case CoalesceTable::COALESCED:
+                bump(impl->producer.coalesced);
+                return true;
+            case CoalesceTable::CLAIMED: {
+                    // queue just the slot index; the record stays in the table
+                    void *ref = nullptr;
+                    if (!queue->send_acquire(&ref, sizeof(index), 0)) {
+                        impl->coalesce.cancel(index);
+                        bump(impl->producer.acquireFail);
+                        return false;
+                    }
+                    memcpy(ref, &index, sizeof(index));
+                    if (!queue->send_complete(ref)) {
+                        impl->coalesce.cancel(index);
+                        bump(impl->producer.queueFull);
+                        return false;
+                    }
+                    sampleOccupancy(impl, queue);
+                    return true;
+                }
+            case CoalesceTable::FULL:
+                // no slot, or too big for one: queue the full record
+                if (hdr.size() <= CoalesceTable::SLOT_SIZE)
+                    bump(impl->producer.coalesceFull);
+                break;
+        }
+    }
 
-        if (advertisedDevice.haveManufacturerData()) {
-            String hexData;
-            stringToHexString(advertisedDevice.getManufacturerData(), hexData);
-            BLEdata["mfd"] = hexData;
+    size_t size = hdr.size();
+    void *slot = nullptr;
+    bool ok = queue->send_acquire(&slot, size, 0);
+    if (!ok && impl->overloadPolicy == BLEScanner::OverloadPolicy::DropOldest) {
+        while (!ok && queue->discard_oldest()) {
+            bump(impl->producer.evicted);
+            ok = queue->send_acquire(&slot, size, 0);
         }
+    }
+    if (!ok) {
+        bump(impl->producer.acquireFail);
+        return false;
+    }
+
+    AdvRecord *rec = static_cast<AdvRecord *>(slot);
+    memcpy(rec, &hdr, sizeof(AdvRecord));
+    memcpy(rec->ad(), ad, hdr.adLen);
+
+    if (!queue->send_complete(rec)) {
+        bump(impl->producer.queueFull);
+        return false;
+    }
+    // a pending slot of this device now holds older data; later adverts
+    // must not coalesce into it and overtake the record just queued
+    if (impl->overloadPolicy == BLEScanner::OverloadPolicy::CoalesceByMac)
+        impl->coalesce.drop(hdr.mac);
+    sampleOccupancy(impl, queue);
+    return true;
+}
+
+// A record taken off a queue: borrowed in place, or copied out of its
+// coalesce slot when the queue item is just a slot index.
+struct TakenRecord {
+    ItemQueue *queue = nullptr; // lane the item came from
+    void *item = nullptr; // queue item still held, if any
+    const AdvRecord *rec = nullptr;
+    alignas(8) uint8_t copy[CoalesceTable::SLOT_SIZE];
+};
 
-        if (advertisedDevice.haveServiceUUID())
-            BLEdata["svcuuid"] = (char *)advertisedDevice.getServiceUUID().toString().c_str();
+static const AdvRecord *validRecord(const void *buffer, size_t size) {
+    const AdvRecord *rec = static_cast<const AdvRecord *>(buffer);
+    if (size < sizeof(AdvRecord) || rec->size() > size) {
+        log_e("malformed record: %u bytes", (unsigned)size);
+        return nullptr;
+    }
+    return rec;
+}
+
+// How long a consumer blocks on the high lane before looking at the low
+// lane again; bounds the extra latency of low-priority adverts.
+static constexpr uint32_t LANE_POLL_MS = 10;
 
-        int sdCount = advertisedDevice.getServiceDataUUIDCount();
-        if (sdCount > 0) {
-            int idx = sdCount - 1;
-            BLEdata["svduuid"] = (char *)advertisedDevice.getServiceDataUUID(idx).toString().c_str();
-            String hexData;
-            stringToHexString(advertisedDevice.getServiceData(idx), hexData);
-            BLEdata["sd"] = hexData;
+/// Take the oldest item of the highest non-empty lane, waiting up to waitMs.
+/// Returns false if all lanes are empty. t.rec is nullptr for a malformed item.
+static bool takeRecord(BLEScanner::Impl *impl, const LaneQueues &queues,
+                       uint32_t waitMs, TakenRecord &t) {
+    ItemQueue *high = queues.lane[(size_t)BLEScanner::Lane::High];
+    ItemQueue *low = queues.lane[(size_t)BLEScanner::Lane::Low];
+    size_t size = 0;
+    t.rec = nullptr;
+    t.item = nullptr;
+
+    while (true) {
+        if (!low) {
+            t.queue = high;
+            t.item = high->receive(&size, waitMs);
+            break;
         }
+        t.queue = high;
+        t.item = high->receive(&size, 0);
+        if (t.item)
+            break;
+        t.queue = low;
+        t.item = low->receive(&size, 0);
+        if (t.item || waitMs == 0)
+            break;
+        uint32_t slice = waitMs < LANE_POLL_MS ? waitMs : LANE_POLL_MS;
+        t.queue = high;
+        t.item = high->receive(&size, slice);
+        if (t.item)
+            break;
+        waitMs -= slice;
+    }
+    if (t.item == nullptr)
+        return false;
+
+    ItemQueue *queue = t.queue;
+    if (size == sizeof(uint16_t)) {
+        uint16_t index;
+        memcpy(&index, t.item, sizeof(index));
+        queue->return_item(t.item);
+        t.item = nullptr;
+        size = impl->coalesce.take(index, t.copy);
+        t.rec = validRecord(t.copy, size);
+    } else {
+        t.rec = validRecord(t.item, size);
+    }
+    return true;
+}
 
-        if (advertisedDevice.haveTXPower())
-            BLEdata["txpwr"] = (int8_t)advertisedDevice.getTXPower();
+static void releaseRecord(TakenRecord &t) {
+    if (t.item)
+        t.queue->return_item(t.item);
+    t.item = nullptr;
+    t.rec = nullptr;
+}
 
-        BLEdata["time"] = fseconds();
+static void recordLatency(BLEScanner::Impl *impl, BLEScanner::Stage stage, int64_t us) {
+    impl->latency[(size_t)stage].record(us > 0 ? (uint32_t)us : 0);
+}
 
-        void *ble_adv = nullptr;
-        size_t total = measureMsgPack(BLEdata);
-        if (s_impl->queue->send_acquire((void **)&ble_adv, total, 0) != pdTRUE) {
-            s_impl->acquireFail++;
-            return;
+// Consumer side of tracing, once rec has been decoded into doc: records
+// the Queue and Decode stages and tags sampled adverts. Returns the time
+// decoding finished.
+static int64_t traceDecoded(BLEScanner::Impl *impl, const AdvRecord *rec,
+                            int64_t dequeuedUs, JsonDocument &doc) {
+    int64_t queuedUs = rec->timeUs + rec->queuedUs;
+    int64_t now = esp_timer_get_time();
+    recordLatency(impl, BLEScanner::Stage::Queue, dequeuedUs - queuedUs);
+    recordLatency(impl, BLEScanner::Stage::Decode, now - dequeuedUs);
+    if (rec->traceId) {
+        JsonObject trace = doc["trace"].to<JsonObject>();
+        trace["id"] = rec->traceId;
+        trace["enq"] = rec->queuedUs;
+        trace["deq"] = dequeuedUs - (int64_t)rec->timeUs;
+    }
+    return now;
+}
+
+// Handler side: Output, Publish and Total for one advert handed out at
+// startUs whose handler returned at endUs.
+static void tracePublished(BLEScanner::Impl *impl, uint64_t timeUs, int64_t decodedUs,
+                           int64_t startUs, int64_t endUs) {
+    recordLatency(impl, BLEScanner::Stage::Output, startUs - decodedUs);
+    recordLatency(impl, BLEScanner::Stage::Publish, endUs - startUs);
+    recordLatency(impl, BLEScanner::Stage::Total, endUs - (int64_t)timeUs);
+}
+
+// ---------------------------------------------------------------------------
+// BLE scan callback — enqueues a binary AdvRecord with the raw AD payload
+// ---------------------------------------------------------------------------
+
+// Holds the active filter for its lifetime, counted in Impl::filterUsers
+// under the current generation so setFilter() does not free it meanwhile.
+class FilterRef {
+public:
+    explicit FilterRef(BLEScanner::Impl *impl) : _impl(impl) {
+        // if setFilter() moved on while we registered, register again
+        _gen = impl->filterGen.load() & 1;
+        impl->filterUsers[_gen].fetch_add(1);
+        while ((impl->filterGen.load() & 1) != _gen) {
+            impl->filterUsers[_gen].fetch_sub(1);
+            _gen ^= 1;
+            impl->filterUsers[_gen].fetch_add(1);
         }
+        _filter = impl->filter;
+    }
+    ~FilterRef() {
+        _impl->filterUsers[_gen].fetch_sub(1);
+    }
+    FilterRef(const FilterRef &) = delete;
+    FilterRef &operator=(const FilterRef &) = delete;
 
-        size_t n = serializeMsgPack(BLEdata, ble_adv, total);
-        if (n != total) {
-            log_e("serializeMsgPack: expected %u got %u", total, n);
-        } else {
-            if (s_impl->queue->send_complete(ble_adv) != pdTRUE) {
-                s_impl->queueFull++;
-            } else {
-                s_impl->queue->update_high_watermark();
-            }
+    const AdvFilter *get() const {
+        return _filter;
+    }
+
+private:
+    BLEScanner::Impl *_impl;
+    uint32_t _gen;
+    const AdvFilter *_filter;
+};
+
+// Filter, dedup and queue one (possibly merged) advert. The caller holds
+// a CounterWrite on producer.seq.
+static void admitRecord(const AdvRecord &hdr, const uint8_t *ad) {
+    LaneQueues *queues = s_impl->queuesFor(hdr.mac);
+    if (!queues->lane[0])
+        return;
+    ProducerCounters &counters = s_impl->producer;
+
+    // Drop unwanted adverts before touching the queue
+    AdvFilter::Verdict verdict = AdvFilter::PASS;
+    {
+        FilterRef filter(s_impl);
+        if (filter.get())
+            verdict = filter.get()->check(hdr.mac, ad, hdr.adLen);
+    }
+    if (verdict != AdvFilter::PASS) {
+        bump(counters.filtered[verdict]);
+        return;
+    }
+
+    if (s_impl->dedupWindowMs) {
+        switch (s_impl->dedup.check(macKey(hdr.mac), ad, hdr.adLen,
+                                    (uint32_t)(hdr.timeUs / 1000))) {
+            case DedupCache::SUPPRESS:
+                bump(counters.suppressed);
+                return;
+            case DedupCache::REEMIT:
+                bump(counters.reemitted);
+                break;
+            default:
+                break;
         }
     }
+
+    BLEScanner::Lane lane = hasDecoder(ad, hdr.adLen) ? BLEScanner::Lane::High
+                            : BLEScanner::Lane::Low;
+
+    AdvRecord rec = hdr;
+    rec.queuedUs = (uint32_t)(esp_timer_get_time() - hdr.timeUs);
+    rec.traceId = 0;
+    if (s_impl->traceEvery && s_impl->traceCountdown-- == 0) {
+        s_impl->traceCountdown = s_impl->traceEvery - 1;
+        rec.traceId = ++s_impl->traceSeq ? s_impl->traceSeq : ++s_impl->traceSeq;
+    }
+    if (pushRecord(s_impl, queues->forLane(lane), rec, ad)) {
+        bump(counters.laneQueued[(size_t)lane]);
+        s_impl->latency[(size_t)BLEScanner::Stage::Admit].record(rec.queuedUs);
+    } else {
+        bump(counters.laneDropped[(size_t)lane]);
+        // nothing was published, so repeats of this payload must not be
+        // suppressed as duplicates of it
+        if (s_impl->dedupWindowMs)
+            s_impl->dedup.forget(macKey(hdr.mac));
+    }
+}
+
+// Periodic flush of adverts whose scan response never came.
+static void mergeExpire(void *) {
+    std::lock_guard<std::mutex> guard(s_impl->mergeLock);
+    CounterWrite update(s_impl->producer.seq);
+    s_impl->merge.expire(esp_timer_get_time(), admitRecord);
+}
+
+// Entry point for every scan result: through the scan response merge
+// buffer if enabled, then filter, dedup and queue.
+static void offerRecord(const AdvRecord &hdr, const uint8_t *ad) {
+    if (s_impl->merge.enabled()) {
+        std::lock_guard<std::mutex> guard(s_impl->mergeLock);
+        CounterWrite update(s_impl->producer.seq);
+        s_impl->merge.offer(hdr, ad, admitRecord);
+    } else {
+        CounterWrite update(s_impl->producer.seq);
+        admitRecord(hdr, ad);
+    }
+}
+
+#ifdef ESP_PLATFORM
+// Scan results are taken from the raw GAP event rather than from
+// BLEAdvertisedDevice, which does not say whether a result is an advert or
+// the scan response to one (ble_evt_type).
+static void gapHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
+    if (event != ESP_GAP_BLE_SCAN_RESULT_EVT || !s_impl)
+        return;
+    const auto &r = param->scan_rst;
+    if (r.search_evt != ESP_GAP_SEARCH_INQ_RES_EVT)
+        return;
+
+    // longest silence between callbacks: shows scan restart gaps
+    int64_t now = esp_timer_get_time();
+    if (s_impl->lastResultUs)
+        bumpMax(s_impl->maxGapUs, (uint32_t)(now - s_impl->lastResultUs));
+    s_impl->lastResultUs = now;
+
+    AdvRecord hdr;
+    memcpy(hdr.mac, r.bda, sizeof(hdr.mac));
+    hdr.rssi = (int8_t)r.rssi;
+    hdr.timeUs = now;
+    hdr.flags = 0;
+    hdr.txPower = 0;
+
+    // a scan response may be reported behind the advert it answers; keep
+    // just the response, the advert had its own result
+    const uint8_t *payload = r.ble_adv;
+    size_t adLen = r.adv_data_len + r.scan_rsp_len;
+    if (r.ble_evt_type == ESP_BLE_EVT_SCAN_RSP) {
+        hdr.flags |= ADV_FLAG_SCAN_RSP;
+        payload += r.adv_data_len;
+        adLen = r.scan_rsp_len;
+    } else if (r.ble_evt_type == ESP_BLE_EVT_CONN_ADV ||
+               r.ble_evt_type == ESP_BLE_EVT_DISC_ADV) {
+        hdr.flags |= ADV_FLAG_SCANNABLE;
+    }
+    if (adLen > ADV_MAX_AD_LEN)
+        adLen = ADV_MAX_AD_LEN;
+    hdr.adLen = adLen;
+
+    forEachAD(payload, adLen, [&](uint8_t type, const uint8_t *data, size_t len) {
+        if (type == AD_TYPE_TX_POWER && len >= 1) {
+            hdr.txPower = (int8_t)data[0];
+            hdr.flags |= ADV_FLAG_TXPWR;
+        }
+    });
+    offerRecord(hdr, payload);
+}
+
+// BLEScan keeps every result unless a callback takes it; the records
+// themselves come from gapHandler().
+class ScanCallback : public BLEAdvertisedDeviceCallbacks {
+    void onResult(BLEAdvertisedDevice) override {}
 };
 
 // ---------------------------------------------------------------------------
 // Scan task (runs forever on its own RTOS task)
 // ---------------------------------------------------------------------------
+static void scanComplete(BLEScanResults) {
+    if (s_impl)
+        s_impl->scanning = false;
+}
+
 static void scanTask(void *param) {
     auto *impl = static_cast<BLEScanner::Impl *>(param);
 
     BLEDevice::init("");
+    BLEDevice::setCustomGapHandler(gapHandler);
     impl->pBLEScan = BLEDevice::getScan();
     impl->pBLEScan->setAdvertisedDeviceCallbacks(new ScanCallback(), true, true);
     impl->pBLEScan->setActiveScan(impl->activeScan);
     impl->pBLEScan->setInterval(impl->scanInterval);
     impl->pBLEScan->setWindow(impl->scanWindow);
 
+    // Callbacks are registered with wantDuplicates, so BLEScan stores no
+    // results. Continuous mode starts one unbounded scan and only restarts
+    // it if the stack ends it; windowed mode restarts every scanTimeMs.
+    while (impl->continuousScan) {
+        if (!impl->scanning) {
+            if (peek(impl->scanStarts))
+                log_w("scan stopped, restarting");
+            bump(impl->scanStarts);
+            impl->scanning = true;
+            if (!impl->pBLEScan->start(0, scanComplete, false))
+                impl->scanning = false;
+        }
+        delay(1000);
+    }
+
     while (true) {
+        bump(impl->scanStarts);
         BLEScanResults *foundDevices = impl->pBLEScan->start(impl->scanTimeMs / 1000, false);
         log_d("Devices found: %d", foundDevices->getCount());
         impl->pBLEScan->clearResults();
         delay(1);
     }
 }
+#endif // ESP_PLATFORM
 
 // ---------------------------------------------------------------------------
 // BLEScanner public API
@@ -512,7 +1031,20 @@ void BLEScanner::setBTHomeKey(const char *hexKey) {
         _impl = new Impl();
         s_impl = _impl;
     }
-    _impl->bthKey = hexKey ? hexKey : "";
+    uint8_t key[16];
+    size_t len = hexKey ? strlen(hexKey) : 0;
+    bool valid = len == 2 * sizeof(key) && hexDecode(hexKey, len, key);
+    if (len && !valid)
+        log_e("BTHome key must be %u hex digits", (unsigned)(2 * sizeof(key)));
+    _impl->bthKeys.setDefaultKey(valid ? key : nullptr);
+}
+
+BTHomeKeyStore *BLEScanner::bthomeKeys() {
+    if (!_impl) {
+        _impl = new Impl();
+        s_impl = _impl;
+    }
+    return &_impl->bthKeys;
 }
 
 void BLEScanner::setActiveScan(bool active) {
@@ -523,27 +1055,379 @@ void BLEScanner::setActiveScan(bool active) {
     _impl->activeScan = active;
 }
 
+void BLEScanner::setContinuousScan(bool continuous) {
+    if (!_impl) {
+        _impl = new Impl();
+        s_impl = _impl;
+    }
+    _impl->continuousScan = continuous;
+}
+
+void BLEScanner::setScanResponseMerge(uint32_t timeoutMs, size_t slots) {
+    if (!_impl) {
+        _impl = new Impl();
+        s_impl = _impl;
+    }
+    _impl->mergeTimeoutMs = timeoutMs;
+    _impl->mergeSlots = slots;
+}
+
+void BLEScanner::setLowPriorityLane(size_t ringBufSize) {
+    if (!_impl) {
+        _impl = new Impl();
+        s_impl = _impl;
+    }
+    _impl->lowLaneSize = ringBufSize;
+}
+
+void BLEScanner::setRawUnknown(bool publish) {
+    if (!_impl) {
+        _impl = new Impl();
+        s_impl = _impl;
+    }
+    _impl->rawUnknown = publish;
+}
+
+void BLEScanner::setTraceSampling(uint32_t every) {
+    if (!_impl) {
+        _impl = new Impl();
+        s_impl = _impl;
+    }
+    _impl->traceEvery = every;
+}
+
+void BLEScanner::setFastTierSize(size_t bytes) {
+    if (!_impl) {
+        _impl = new Impl();
+        s_impl = _impl;
+    }
+    _impl->fastTierSize = bytes;
+}
+
+void BLEScanner::setDedup(uint32_t windowMs, uint32_t reemitMs, size_t cacheSize) {
+    if (!_impl) {
+        _impl = new Impl();
+        s_impl = _impl;
+    }
+    if (windowMs && !reemitMs)
+        log_w("dedup without re-emit: unchanged devices will go silent");
+    _impl->dedupWindowMs = windowMs;
+    _impl->dedupReemitMs = reemitMs;
+    _impl->dedupEntries = cacheSize;
+}
+
+void BLEScanner::setDeviceTable(size_t capacity, UBaseType_t caps) {
+    if (!_impl) {
+        _impl = new Impl();
+        s_impl = _impl;
+    }
+    _impl->deviceCapacity = capacity;
+    _impl->deviceCaps = caps;
+}
+
+void BLEScanner::setMeasurementSink(MeasurementSink *sink) {
+    if (!_impl) {
+        _impl = new Impl();
+        s_impl = _impl;
+    }
+    _impl->sink = sink;
+}
+
+DeviceTable *BLEScanner::devices() {
+    if (!_impl || !_impl->devices.capacity())
+        return nullptr;
+    return &_impl->devices;
+}
+
+void BLEScanner::setFilter(const AdvFilter &filter) {
+    if (!_impl) {
+        _impl = new Impl();
+        s_impl = _impl;
+    }
+    const AdvFilter *next = filter.empty() ? nullptr : new AdvFilter(filter);
+    const AdvFilter *prev = _impl->filter.exchange(next);
+    // A caller that may have loaded prev is counted under the old
+    // generation until it is done with it. Callers from here on count under
+    // the new one and see next, so steady traffic cannot keep the old count
+    // from draining.
+    uint32_t old = _impl->filterGen.fetch_add(1) & 1;
+    while (_impl->filterUsers[old].load())
+        delay(1);
+    delete prev;
+}
+
+size_t BLEScanner::filterHits(AdvFilter::RuleHits *out, size_t maxRules) const {
+    if (!_impl)
+        return 0;
+    FilterRef filter(_impl);
+    return filter.get() ? filter.get()->ruleHits(out, maxRules) : 0;
+}
+
+void BLEScanner::setOverloadPolicy(OverloadPolicy policy, size_t coalesceSlots) {
+    if (!_impl) {
+        _impl = new Impl();
+        s_impl = _impl;
+    }
+    _impl->overloadPolicy = policy;
+    _impl->coalesceSlots = coalesceSlots;
+}
+
+void BLEScanner::setWorkers(uint8_t count, int core, uint32_t stackSize,
+                            UBaseType_t priority) {
+    if (!_impl) {
+        _impl = new Impl();
+        s_impl = _impl;
+    }
+    _impl->workerCount = count;
+    _impl->workerCore = core;
+    _impl->workerStackSize = stackSize;
+    _impl->workerPriority = priority;
+}
+
+size_t BLEScanner::workerCount() const {
+    return _impl && _started ? _impl->workerCount : 0;
+}
+
+BLEScanner::WorkerStats BLEScanner::workerStats(size_t idx) const {
+    WorkerStats w = {};
+    if (idx >= workerCount())
+        return w;
+    const DecodeWorker &dw = _impl->workers[idx];
+    int64_t elapsed = esp_timer_get_time() - dw.startUs;
+    uint64_t busyUs = 0;
+    dw.seq.read([&] {
+        w.processed   = peek(dw.processed);
+        w.decoded     = peek(dw.decoded);
+        w.outputDrops = peek(dw.outputDrops);
+        busyUs        = dw.busyUs.load(std::memory_order_relaxed);
+    });
+    w.utilization = elapsed > 0 ? (uint8_t)((busyUs * 100) / elapsed) : 0;
+    for (ItemQueue *q : dw.queues.lane) {
+        if (q) {
+            w.queueBytes += q->get_current_usage();
+            w.hwmBytes   += q->get_high_watermark();
+        }
+    }
+    return w;
+}
+
+BLEScanner::LaneStats BLEScanner::laneStats(Lane lane) const {
+    LaneStats l = {};
+    if (!_impl || !_started)
+        return l;
+    size_t idx = (size_t)lane;
+    const ProducerCounters &pc = _impl->producer;
+    pc.seq.read([&] {
+        l.queued  = peek(pc.laneQueued[idx]);
+        l.dropped = peek(pc.laneDropped[idx]);
+    });
+    auto add = [&l, idx](const LaneQueues &queues) {
+        if (ItemQueue *q = queues.lane[idx]) {
+            l.queueBytes += q->get_current_usage();
+            l.hwmBytes   += q->get_high_watermark();
+            l.totalBytes += q->get_total_size();
+        }
+    };
+    add(_impl->queues);
+    for (size_t i = 0; i < _impl->workerCount; i++)
+        add(_impl->workers[i].queues);
+    return l;
+}
+
+BLEScanner::LatencyStats BLEScanner::latency(Stage stage, bool reset) {
+    LatencyStats l = {};
+    if (!_impl || (size_t)stage >= STAGE_COUNT)
+        return l;
+    LatencyHistogram::Summary s = _impl->latency[(size_t)stage].take(reset);
+    l.count = s.count;
+    l.p50Us = s.p50Us;
+    l.p99Us = s.p99Us;
+    l.maxUs = s.maxUs;
+    return l;
+}
+
 BLEScanner::Stats BLEScanner::stats() const {
     Stats s = {};
-    if (!_impl || !_impl->queue)
+    if (!_impl || !_started)
         return s;
-    s.hwmBytes    = _impl->queue->get_high_watermark();
-    s.totalBytes  = _impl->queue->get_total_size();
+    s.timeUs = esp_timer_get_time();
+    if (ItemQueue *q = _impl->queues.lane[0]) {
+        s.hwmBytes   = q->get_high_watermark();
+        s.totalBytes = q->get_total_size();
+    }
+
+    // Consumers first: every advert they count was counted by the producer
+    // before it was queued, so received never runs ahead of queued.
+    const ConsumerCounters &cc = _impl->consumer;
+    cc.seq.read([&] {
+        s.received = peek(cc.received);
+        s.decoded  = peek(cc.decoded);
+    });
+    for (size_t i = 0; i < _impl->workerCount; i++) {
+        const DecodeWorker &dw = _impl->workers[i];
+        // report the fullest shard
+        ItemQueue *q = dw.queues.lane[0];
+        if (q->get_high_watermark() > s.hwmBytes) {
+            s.hwmBytes   = q->get_high_watermark();
+            s.totalBytes = q->get_total_size();
+        }
+        uint32_t processed = 0, decoded = 0;
+        dw.seq.read([&] {
+            processed = peek(dw.processed);
+            decoded   = peek(dw.decoded);
+        });
+        s.received += processed;
+        s.decoded  += decoded;
+    }
     s.hwmPercent  = s.totalBytes > 0 ? (uint8_t)((s.hwmBytes * 100) / s.totalBytes) : 0;
-    s.queueFull   = _impl->queueFull;
-    s.acquireFail = _impl->acquireFail;
-    s.received    = _impl->received;
-    s.decoded     = _impl->decoded;
+
+    const ProducerCounters &pc = _impl->producer;
+    pc.seq.read([&] {
+        s.queueFull   = peek(pc.queueFull);
+        s.acquireFail = peek(pc.acquireFail);
+        s.filterMac      = peek(pc.filtered[AdvFilter::DENY_MAC]);
+        s.filterCompany  = peek(pc.filtered[AdvFilter::DENY_COMPANY]);
+        s.filterUuid     = peek(pc.filtered[AdvFilter::DENY_UUID]);
+        s.filterNotAllowed = peek(pc.filtered[AdvFilter::NOT_ALLOWED]);
+        s.suppressed  = peek(pc.suppressed);
+        s.reemitted   = peek(pc.reemitted);
+        s.evicted     = peek(pc.evicted);
+        s.coalesced   = peek(pc.coalesced);
+        s.coalesceFull = peek(pc.coalesceFull);
+        s.queued = 0;
+        for (const Counter &c : pc.laneQueued)
+            s.queued += peek(c);
+        for (size_t i = 0; i < OCCUPANCY_BUCKETS; i++)
+            s.occupancy[i] = peek(pc.occupancy[i]);
+        s.scanMerged    = _impl->merge.merged();
+        s.scanUnmatched = _impl->merge.unmatched();
+    });
+
+#ifdef ESP_PLATFORM
+    for (const espidf::TieredRingBuffer *q : _impl->tiered) {
+        s.spilledItems += q->get_spilled_items();
+        s.spilledBytes += q->get_spilled_bytes();
+        if (q->spill_tier().get_high_watermark() > s.spillHwmBytes)
+            s.spillHwmBytes = q->spill_tier().get_high_watermark();
+    }
+#endif
+    uint32_t starts = peek(_impl->scanStarts);
+    s.scanRestarts = starts ? starts - 1 : 0;
+    s.maxGapMs    = peek(_impl->maxGapUs) / 1000;
+    s.heapFree    = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    s.heapMinFree = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
     return s;
 }
 
+BLEScanner::Rates BLEScanner::rates(const Stats &prev, const Stats &now) {
+    Rates r = {};
+    if (now.timeUs <= prev.timeUs)
+        return r;
+    float secs = (now.timeUs - prev.timeUs) * 1.0e-6f;
+    auto dropped = [](const Stats &s) {
+        return s.acquireFail + s.queueFull + s.evicted;
+    };
+    auto filtered = [](const Stats &s) {
+        return s.filterMac + s.filterCompany + s.filterUuid + s.filterNotAllowed;
+    };
+    r.queued     = (now.queued - prev.queued) / secs;
+    r.received   = (now.received - prev.received) / secs;
+    r.decoded    = (now.decoded - prev.decoded) / secs;
+    r.dropped    = (dropped(now) - dropped(prev)) / secs;
+    r.filtered   = (filtered(now) - filtered(prev)) / secs;
+    r.suppressed = (now.suppressed - prev.suppressed) / secs;
+    return r;
+}
+
+// NOSPLIT ring buffer: the FreeRTOS one on the device, HostRingBuffer
+// elsewhere (which has no spill tier; QueueType::Tiered falls back to it).
+// nullptr if the storage cannot be allocated.
+static ItemQueue *createRing(size_t size, UBaseType_t cap) {
+#ifdef ESP_PLATFORM
+    auto *q = new espidf::RingBuffer();
+    q->create(size, RINGBUF_TYPE_NOSPLIT, cap);
+#else
+    (void)cap;
+    auto *q = new HostRingBuffer();
+    if (!q->create(size)) {
+        log_e("ring buffer allocation failed (%u bytes)", (unsigned)size);
+        delete q;
+        return nullptr;
+    }
+#endif
+    return q;
+}
+
+static ItemQueue *createQueue(BLEScanner::Impl *impl, BLEScanner::QueueType type,
+                              size_t size, UBaseType_t cap) {
+    if (type == BLEScanner::QueueType::Spsc) {
+        auto *q = new SpscQueue();
+        if (q->create(size, cap))
+            return q;
+        log_e("SPSC queue allocation failed, using a ring buffer");
+        delete q;
+        return createRing(size, cap);
+    }
+#ifdef ESP_PLATFORM
+    if (type == BLEScanner::QueueType::Tiered) {
+        // the front never needs to be bigger than the queue itself
+        size_t fastSize = impl->fastTierSize < size ? impl->fastTierSize : size;
+        auto *q = new espidf::TieredRingBuffer();
+        if (q->create(fastSize, size, MALLOC_CAP_INTERNAL, cap)) {
+            impl->tiered.push_back(q);
+            return q;
+        }
+        log_e("tiered queue allocation failed, using a plain ring buffer");
+        delete q;
+    }
+#endif
+    return createRing(size, cap);
+}
+
+// False if a lane could not be allocated.
+static bool createLanes(BLEScanner::Impl *impl, LaneQueues &queues,
+                        BLEScanner::QueueType type, size_t size, size_t lowSize,
+                        UBaseType_t cap) {
+    queues.lane[(size_t)BLEScanner::Lane::High] = createQueue(impl, type, size, cap);
+    // Internal SRAM is kept for the high lane: a tiered low lane would
+    // spend a fast tier on adverts nobody decodes.
+    if (type == BLEScanner::QueueType::Tiered)
+        type = BLEScanner::QueueType::RingBuffer;
+    if (lowSize)
+        queues.lane[(size_t)BLEScanner::Lane::Low] = createQueue(impl, type, lowSize, cap);
+    return queues.lane[(size_t)BLEScanner::Lane::High] &&
+           (!lowSize || queues.lane[(size_t)BLEScanner::Lane::Low]);
+}
+
+static void freeLanes(LaneQueues &queues) {
+    for (ItemQueue *&q : queues.lane) {
+        delete q;
+        q = nullptr;
+    }
+}
+
+// Undo a begin() whose queues could not all be allocated. The workers stay
+// allocated but without queues, so a merge expiry that is already running
+// drops its adverts.
+static void freeQueues(BLEScanner::Impl *impl) {
+    freeLanes(impl->queues);
+    for (size_t i = 0; impl->workers && i < impl->workerCount; i++)
+        freeLanes(impl->workers[i].queues);
+    delete impl->output;
+    impl->output = nullptr;
+#ifdef ESP_PLATFORM
+    impl->tiered.clear();
+#endif
+}
+
 void BLEScanner::begin(size_t ringBufSize,
                        uint32_t scanTimeMs,
                        uint16_t scanInterval,
                        uint16_t scanWindow,
                        uint32_t taskStackSize,
                        UBaseType_t taskPriority,
-                       UBaseType_t ringBufCap) {
+                       UBaseType_t ringBufCap,
+                       QueueType queueType) {
     if (_started)
         return;
     _started = true;
@@ -557,96 +1441,417 @@ void BLEScanner::begin(size_t ringBufSize,
     _impl->scanInterval = scanInterval;
     _impl->scanWindow = scanWindow;
 
-    _impl->queue = new espidf::RingBuffer();
-    _impl->queue->create(ringBufSize, RINGBUF_TYPE_NOSPLIT, ringBufCap);
+    if (_impl->dedupWindowMs)
+        _impl->dedup.create(_impl->dedupEntries, _impl->dedupWindowMs, _impl->dedupReemitMs);
+
+    if (_impl->activeScan && _impl->mergeTimeoutMs && _impl->mergeSlots) {
+        _impl->merge.create(_impl->mergeSlots, _impl->mergeTimeoutMs);
+#ifdef ESP_PLATFORM
+        esp_timer_create_args_t args = {};
+        args.callback = mergeExpire;
+        args.name = "ble_merge";
+        esp_timer_create(&args, &_impl->mergeTimer);
+        esp_timer_start_periodic(_impl->mergeTimer, _impl->mergeTimeoutMs * 500ull);
+#endif
+    }
+
+    if (_impl->deviceCapacity &&
+            !_impl->devices.create(_impl->deviceCapacity, _impl->deviceCaps))
+        log_e("device table allocation failed (%u entries)", (unsigned)_impl->deviceCapacity);
+
+    _impl->bthDecoder.setKeyStore(&_impl->bthKeys);
+
+    if (_impl->overloadPolicy == OverloadPolicy::DropOldest &&
+            queueType == QueueType::Spsc) {
+        // the SPSC tail belongs to the consumer; the producer cannot evict
+        log_w("DropOldest needs QueueType::RingBuffer, using DropNewest");
+        _impl->overloadPolicy = OverloadPolicy::DropNewest;
+    }
+    if (_impl->overloadPolicy == OverloadPolicy::CoalesceByMac)
+        _impl->coalesce.create(_impl->coalesceSlots);
+
+    if (_impl->workerCount) {
+        _impl->output = createRing(ringBufSize, ringBufCap);
+        _impl->workers = new DecodeWorker[_impl->workerCount];
+        bool ok = _impl->output != nullptr;
+        for (size_t i = 0; i < _impl->workerCount; i++)
+            ok &= createLanes(_impl, _impl->workers[i].queues, queueType, ringBufSize,
+                              _impl->lowLaneSize, ringBufCap);
+        if (!ok) {
+            log_e("queue allocation failed, scanner not started");
+            freeQueues(_impl);
+            _started = false;
+            return;
+        }
+        for (size_t i = 0; i < _impl->workerCount; i++) {
+            DecodeWorker &dw = _impl->workers[i];
+            dw.startUs = esp_timer_get_time();
+
+#ifdef ESP_PLATFORM
+            // std::thread runs on a pthread-backed FreeRTOS task configured here
+            char name[16];
+            snprintf(name, sizeof(name), "ble_dec%u", (unsigned)i);
+            esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+            cfg.stack_size = _impl->workerStackSize;
+            cfg.prio = _impl->workerPriority;
+            cfg.thread_name = name;
+            cfg.pin_to_core = _impl->workerCore < 0 ? tskNO_AFFINITY : _impl->workerCore;
+            esp_pthread_set_cfg(&cfg);
+#endif
+            dw.thread = std::thread(&BLEScanner::workerLoop, this, i);
+        }
+#ifdef ESP_PLATFORM
+        esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+        esp_pthread_set_cfg(&cfg);
+#endif
+    } else if (!createLanes(_impl, _impl->queues, queueType, ringBufSize,
+                            _impl->lowLaneSize, ringBufCap)) {
+        log_e("queue allocation failed, scanner not started");
+        freeQueues(_impl);
+        _started = false;
+        return;
+    }
 
+#ifdef ESP_PLATFORM
     xTaskCreate(scanTask, "ble_scan", taskStackSize, _impl, taskPriority, nullptr);
+#else
+    (void)taskStackSize;
+    (void)taskPriority;
+#endif
 }
 
-bool BLEScanner::deliver(JsonDocument &rawDoc, JsonDocument &outDoc) {
-    bool decoded = false;
-    std::vector<uint8_t> mfd;
-
-    if (rawDoc.containsKey("svduuid") &&
-            String(rawDoc["svduuid"]).indexOf("fcd2") != -1) {
-        decoded = decodeBTHome(rawDoc.as<JsonObject>(), outDoc,
-                               _impl->bthDecoder, _impl->bthKey);
-    } else if (rawDoc.containsKey("mfd")) {
-        if (hexStringToVector(rawDoc["mfd"], mfd) && mfd.size() >= 2) {
-            uint16_t mfid = mfd[1] << 8 | mfd[0];
-            switch (mfid) {
-                case 0x0499:
-                    decoded = decodeRuuvi(mfd, outDoc);
-                    break;
-                case 0x0059:
-                    decoded = decodeMopeka(mfd, outDoc);
-                    break;
-                case 0x0100:
-                    decoded = decodeTPMS100(mfd, outDoc);
-                    break;
-                case 0x00AC:
-                    decoded = decodeTPMS00AC(mfd, outDoc);
-                    break;
-                case 0x03B1:
-                    decoded = decodeOtodata(mfd, outDoc);
-                    break;
-                case 0xffff:
-                    decoded = decodeRotarexELG(mfd, outDoc,
-                                               rawDoc.as<JsonObject>());
-                    break;
-                case  0x094f:
-                    decoded = decodeMikrotik(mfd, outDoc);
-                    break;
+void BLEScanner::injectAdvert(const uint8_t mac[6], int8_t rssi,
+                              const uint8_t *ad, size_t adLen, uint8_t flags) {
+    if (!_impl || !_started)
+        return;
+    if (adLen > ADV_MAX_AD_LEN)
+        adLen = ADV_MAX_AD_LEN;
+
+    AdvRecord hdr;
+    memcpy(hdr.mac, mac, sizeof(hdr.mac));
+    hdr.rssi = rssi;
+    hdr.timeUs = esp_timer_get_time();
+    hdr.flags = flags & (ADV_FLAG_SCANNABLE | ADV_FLAG_SCAN_RSP);
+    hdr.txPower = 0;
+    hdr.adLen = adLen;
+#ifndef ESP_PLATFORM
+    // no expiry timer here: flush held adverts on the caller's thread
+    if (_impl->merge.enabled())
+        mergeExpire(nullptr);
+#endif
+    offerRecord(hdr, ad);
+}
+
+// JSON form of a Measurement: top-level fields, or for BTHome
+// {"bthome_version", "measurements": [{object_id, name, value, unit}]}.
+static void writeMeasurement(const Measurement &m, JsonObject root) {
+    if (m.flags & MEASUREMENT_BTHOME) {
+        root["bthome_version"] = m.version;
+        JsonArray measArr = root["measurements"].to<JsonArray>();
+        for (size_t i = 0; i < m.count; i++) {
+            const MeasurementField &f = m.fields[i];
+            JsonObject obj = measArr.add<JsonObject>();
+            obj["object_id"] = f.objectId;
+            obj["name"]      = f.key;
+            obj["value"]     = f.f;
+            obj["unit"]      = f.unit;
+        }
+        return;
+    }
+    if (m.dev)
+        root["dev"] = m.dev;
+    for (size_t i = 0; i < m.count; i++) {
+        const MeasurementField &f = m.fields[i];
+        switch (f.type) {
+            case FieldType::Float:
+                root[f.key] = f.f;
+                break;
+            case FieldType::Double:
+                root[f.key] = f.d;
+                break;
+            case FieldType::Int:
+                root[f.key] = f.i;
+                break;
+            case FieldType::Uint:
+                root[f.key] = f.u;
+                break;
+            case FieldType::Bool:
+                root[f.key] = f.b;
+                break;
+            case FieldType::Text:
+                root[f.key] = f.s;
+                break;
+            case FieldType::UintText: {
+                char buffer[12];
+                snprintf(buffer, sizeof(buffer), "%lu", (unsigned long)f.u);
+                root[f.key] = buffer;
+                break;
+            }
+        }
+    }
+}
+
+bool BLEScanner::deliver(const AdvView &adv, Measurement &out) {
+    // A service data decoder takes precedence over manufacturer data
+    for (size_t i = 0; i < adv.serviceDataCount; i++) {
+        const AdServiceData &sd = adv.serviceData[i];
+        if (ServiceDecoder decode = serviceDecoderFor(sd.uuid16()))
+            return decode(_impl, adv, sd, out);
+    }
+    const ByteView &mfd = adv.mfd;
+    if (mfd.size() >= 2) {
+        if (MfdDecoder decode = mfdDecoderFor(mfd[1] << 8 | mfd[0]))
+            return decode(mfd, out);
+    }
+    return false;
+}
+
+bool BLEScanner::decodeRecord(const AdvRecord *rec, JsonDocument &doc,
+                              char *mac, size_t macLen) {
+    AdvView adv;
+    viewRecord(rec, adv);
+
+    // Typed values feed the device table and sink; JSON is built only here
+    Measurement m;
+    bool decoded = deliver(adv, m);
+    _impl->devices.update(adv, m, decoded);
+    if (decoded && _impl->sink)
+        _impl->sink->onMeasurement(*rec, m);
+
+    doc.clear();
+    JsonObject root = doc.to<JsonObject>();
+    if (decoded)
+        writeMeasurement(m, root);
+
+    char macStr[18];
+    formatMac(rec->mac, macStr, sizeof(macStr));
+    doc["mac"]  = macStr;
+    doc["rssi"] = rec->rssi;
+    if (!adv.name.empty()) {
+        char name[ADV_MAX_NAME_LEN + 1];
+        size_t n = adv.name.size() > ADV_MAX_NAME_LEN ? ADV_MAX_NAME_LEN : adv.name.size();
+        memcpy(name, adv.name.data(), n);
+        name[n] = '\0';
+        doc["name"] = name;
+    }
+
+    // Undecoded adverts are published raw if enabled; hex is produced only here
+    if (!decoded && _impl->rawUnknown) {
+        char hex[AD_HEX_LEN];
+        char uuid[37];
+        if (!adv.mfd.empty()) {
+            hexEncode(adv.mfd.data(), adv.mfd.size(), hex);
+            doc["mfd"] = hex;
+        }
+        ByteView svcUuid = adv.firstServiceUuid();
+        if (!svcUuid.empty()) {
+            uuidToString(svcUuid.data(), svcUuid.size(), uuid, sizeof(uuid));
+            doc["svcuuid"] = uuid;
+        }
+        if (adv.serviceDataCount) {
+            const AdServiceData &sd = adv.serviceData[0];
+            uuidToString(sd.uuid.data(), sd.uuid.size(), uuid, sizeof(uuid));
+            doc["svduuid"] = uuid;
+            hexEncode(sd.data.data(), sd.data.size(), hex);
+            doc["sd"] = hex;
+        }
+        if (adv.serviceDataCount > 1) {
+            // every service data element, the first one included
+            JsonArray svd = doc["svd"].to<JsonArray>();
+            for (size_t i = 0; i < adv.serviceDataCount; i++) {
+                const AdServiceData &sd = adv.serviceData[i];
+                JsonObject o = svd.add<JsonObject>();
+                uuidToString(sd.uuid.data(), sd.uuid.size(), uuid, sizeof(uuid));
+                o["uuid"] = uuid;
+                hexEncode(sd.data.data(), sd.data.size(), hex);
+                o["data"] = hex;
             }
         }
     }
+
+    if (rec->flags & ADV_FLAG_TXPWR)
+        doc["txpwr"] = rec->txPower;
+    doc["ts"] = rec->timeUs;
+
+    // MAC without colons for the topic
+    if (macLen >= 13)
+        hexFormatMac(rec->mac, mac, '\0');
+    else if (macLen)
+        mac[0] = '\0';
     return decoded;
 }
 
 bool BLEScanner::process(JsonDocument &doc, char *mac, size_t macLen) {
-    if (!_impl || !_impl->queue)
+    uint64_t timeUs;
+    int64_t decodedUs;
+    bool publish;
+    while (processOne(doc, mac, macLen, timeUs, decodedUs, publish)) {
+        if (publish)
+            return true;
+    }
+    return false;
+}
+
+bool BLEScanner::processOne(JsonDocument &doc, char *mac, size_t macLen,
+                            uint64_t &timeUs, int64_t &decodedUs, bool &publish) {
+    publish = false;
+    if (!_impl || !_impl->queues.lane[0])
         return false;
 
-    size_t size = 0;
-    void *buffer = _impl->queue->receive(&size, 0);
-    if (buffer == nullptr)
+    TakenRecord t;
+    if (!takeRecord(_impl, _impl->queues, 0, t))
         return false;
+    if (!t.rec) {
+        releaseRecord(t);
+        return true;
+    }
+    int64_t dequeuedUs = esp_timer_get_time();
+    bool decoded = decodeRecord(t.rec, doc, mac, macLen);
+    timeUs = t.rec->timeUs;
+    decodedUs = traceDecoded(_impl, t.rec, dequeuedUs, doc);
+    releaseRecord(t);
+    {
+        CounterWrite update(_impl->consumer.seq);
+        bump(_impl->consumer.received);
+        if (decoded)
+            bump(_impl->consumer.decoded);
+    }
+    // Undecoded records only feed the device table unless rawUnknown is set
+    publish = decoded || _impl->rawUnknown;
+    return true;
+}
 
-    JsonDocument rawDoc;
-    deserializeMsgPack(rawDoc, buffer, size);
-    _impl->queue->return_item(buffer);
-    _impl->received++;
+void BLEScanner::workerLoop(size_t idx) {
+    DecodeWorker &dw = _impl->workers[idx];
+    JsonDocument doc;
+    OutputHeader out;
 
-    // Decode
-    JsonDocument decodedDoc;
-    bool decoded = deliver(rawDoc, decodedDoc);
-    if (decoded)
-        _impl->decoded++;
-
-    // Pick output document
-    JsonDocument &outDoc = decoded ? decodedDoc : rawDoc;
-
-    // Merge common metadata into decoded results
-    if (decoded) {
-        outDoc["mac"]  = rawDoc["mac"];
-        outDoc["time"] = rawDoc["time"];
-        outDoc["rssi"] = rawDoc["rssi"];
-        if (rawDoc.containsKey("name"))
-            outDoc["name"] = rawDoc["name"];
-        if (rawDoc.containsKey("txpwr"))
-            outDoc["txpwr"] = rawDoc["txpwr"];
-    }
-
-    // Extract MAC (strip colons)
-    String macStr = rawDoc["mac"].as<String>();
-    macStr.replace(":", "");
-    size_t copyLen = macStr.length();
-    if (copyLen >= macLen)
-        copyLen = macLen - 1;
-    memcpy(mac, macStr.c_str(), copyLen);
-    mac[copyLen] = '\0';
-
-    // Move result into caller's doc
-    doc.set(outDoc);
-    return true;
+    TakenRecord t;
+
+    while (true) {
+        if (!takeRecord(_impl, dw.queues, 100, t))
+            continue;
+
+        int64_t start = esp_timer_get_time();
+        bool decoded = false;
+        bool publish = false;
+        bool dropped = false;
+        if (t.rec) {
+            decoded = decodeRecord(t.rec, doc, out.mac, sizeof(out.mac));
+            out.timeUs = t.rec->timeUs;
+            out.decodedUs = traceDecoded(_impl, t.rec, start, doc);
+            publish = decoded || _impl->rawUnknown;
+        }
+        bool processed = t.rec != nullptr;
+        releaseRecord(t);
+
+        if (publish) {
+            size_t len = measureJson(doc);
+            char *item = nullptr;
+            if (!_impl->output->send_acquire((void **)&item, sizeof(out) + len + 1, 0)) {
+                dropped = true;
+            } else {
+                memcpy(item, &out, sizeof(out));
+                serializeJson(doc, item + sizeof(out), len + 1);
+                _impl->output->send_complete(item);
+                _impl->output->update_high_watermark();
+            }
+        }
+
+        CounterWrite update(dw.seq);
+        bump(dw.processed, processed);
+        bump(dw.decoded, decoded);
+        bump(dw.outputDrops, dropped);
+        dw.busyUs.store(dw.busyUs.load(std::memory_order_relaxed) +
+                        (esp_timer_get_time() - start), std::memory_order_relaxed);
+    }
+}
+
+size_t BLEScanner::drainOutput(size_t maxItems, uint32_t maxMicros,
+                               const OutputHandler &handler) {
+    if (!_impl || !_impl->output)
+        return 0;
+
+    int64_t deadline = esp_timer_get_time() + maxMicros;
+    size_t n = 0;
+
+    while (n < maxItems) {
+        size_t size = 0;
+        char *item = (char *)_impl->output->receive(&size, 0);
+        if (item == nullptr)
+            break;
+        OutputHeader out;
+        memcpy(&out, item, sizeof(out)); // items are only 4-byte aligned
+        int64_t start = esp_timer_get_time();
+        handler(out.mac, item + sizeof(out), size - sizeof(out) - 1);
+        tracePublished(_impl, out.timeUs, out.decodedUs, start, esp_timer_get_time());
+        _impl->output->return_item(item);
+        n++;
+        if (maxMicros && esp_timer_get_time() >= deadline)
+            break;
+    }
+    return n;
+}
+
+size_t BLEScanner::unknownSummary(JsonDocument &doc, size_t maxDevices) {
+    doc.clear();
+    JsonObject root = doc.to<JsonObject>();
+    if (!_impl || !_impl->devices.capacity())
+        return 0;
+
+    // devices no decoder has matched, most recently seen first
+    size_t count = 0;
+    uint32_t adverts = 0;
+    JsonArray list = root["devices"].to<JsonArray>();
+    _impl->devices.forEach([&](const DeviceInfo &d) {
+        if (d.decoded)
+            return;
+        count++;
+        adverts += d.adverts;
+        if (list.size() >= maxDevices)
+            return;
+        char mac[13];
+        hexFormatMac(d.mac, mac, '\0');
+        JsonObject o = list.add<JsonObject>();
+        o["mac"] = mac;
+        o["n"] = d.adverts;
+        o["rmin"] = d.rssiMin;
+        o["rmax"] = d.rssiMax;
+        o["first"] = d.firstSeenUs;
+        o["last"] = d.lastSeenUs;
+        if (d.hasCompany)
+            o["cid"] = d.companyId;
+        if (d.name[0])
+            o["name"] = d.name;
+    });
+    root["count"] = count;
+    root["adverts"] = adverts;
+    return count;
+}
+
+size_t BLEScanner::processBatch(size_t maxItems, uint32_t maxMicros,
+                                const Handler &handler) {
+    if (!_impl || !_impl->queues.lane[0])
+        return 0;
+
+    JsonDocument doc;
+    char mac[13];
+    int64_t deadline = esp_timer_get_time() + maxMicros;
+    size_t n = 0;
+
+    uint64_t timeUs;
+    int64_t decodedUs;
+    bool publish;
+    // Every item taken counts against the budget, published or not
+    while (n < maxItems && processOne(doc, mac, sizeof(mac), timeUs, decodedUs, publish)) {
+        if (publish) {
+            int64_t start = esp_timer_get_time();
+            handler(doc, mac);
+            tracePublished(_impl, timeUs, decodedUs, start, esp_timer_get_time());
+        }
+        n++;
+        if (maxMicros && esp_timer_get_time() >= deadline)
+            break;
+    }
+    return n;
 }
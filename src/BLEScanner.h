@@ -1,10 +1,11 @@
 /// @file BLEScanner.h
 /// @brief Singleton BLE advertisement scanner with built-in device decoders.
 ///
-/// Scans for BLE advertisements in a dedicated FreeRTOS task and queues raw
-/// data via a ring buffer. The caller drains the queue from the main loop by
-/// calling process(), which deserializes, decodes (if a known device type is
-/// recognized), and returns a populated JsonDocument plus the device MAC.
+/// Scans for BLE advertisements in a dedicated FreeRTOS task and queues them
+/// as fixed-layout binary records (see advrecord.hpp) via a ring buffer. The
+/// caller drains the queue from the main loop by calling process(), which
+/// walks the record, decodes (if a known device type is recognized), and
+/// returns a populated JsonDocument plus the device MAC.
 ///
 /// Supported device decoders:
 ///   - Ruuvi Tag (V5 format)
@@ -18,7 +19,10 @@
 /// @code
 ///   auto &scanner = BLEScanner::instance();
 ///   scanner.setActiveScan(false);           // optional, before begin()
+///   scanner.setContinuousScan(true);        // optional, no scan window gaps
 ///   scanner.setBTHomeKey("431d39c1...");     // optional, 32-char hex
+///   scanner.setFilter(filter);              // optional, see AdvFilter.h
+///   scanner.setDedup(5000, 30000);          // optional, before begin()
 ///   scanner.begin();                        // starts RTOS scan task
 ///
 ///   // in loop():
@@ -27,15 +31,34 @@
 ///   if (scanner.process(doc, mac, sizeof(mac))) {
 ///       // publish or handle doc + mac
 ///   }
+///
+///   // or drain a burst within a time budget:
+///   scanner.processBatch(16, 2000, [](JsonDocument &doc, const char *mac) {
+///       // publish or handle doc + mac
+///   });
 /// @endcode
 
 #pragma once
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 
 #define ARDUINOJSON_USE_LONG_LONG 1
 #include "ArduinoJson.h"
 
+#ifndef ESP_PLATFORM
+    #include "hostport.hpp"
+#endif
+
+#include "AdvFilter.h"
+
+struct AdvRecord;
+struct AdvView;
+struct Measurement;
+class DeviceTable;
+class MeasurementSink;
+class BTHomeKeyStore;
+
 class BLEScanner {
 public:
     static BLEScanner &instance();
@@ -46,46 +69,289 @@ public:
     /// Opaque implementation detail (defined in BLEScanner.cpp)
     struct Impl;
 
+    /// Advertisement queue implementation.
+    enum class QueueType : uint8_t {
+        RingBuffer, ///< ESP-IDF NOSPLIT ring buffer (critical section per operation)
+        Spsc,       ///< lock-free single-producer/single-consumer queue (spscqueue.hpp)
+        Tiered,     ///< internal SRAM ring spilling into a ringBufCap ring
+                    ///< (espidf::TieredRingBuffer, see setFastTierSize())
+    };
+
+    /// What the scan callback does when an advert does not fit in the queue.
+    enum class OverloadPolicy : uint8_t {
+        DropNewest,    ///< discard the incoming advert (counted in acquireFail)
+        DropOldest,    ///< evict the oldest queued adverts to make room
+                       ///< (QueueType::RingBuffer only)
+        CoalesceByMac, ///< keep only the latest pending advert per device in a
+                       ///< slot table; the queue carries slot indices
+    };
+
+    /// Queue lanes. Adverts with a company ID or service UUID that deliver()
+    /// has a decoder for go to High; everything else goes to Low, which is
+    /// only drained while High is empty.
+    enum class Lane : uint8_t { High, Low };
+    static constexpr size_t LANE_COUNT = 2;
+
+    /// Latency stages of an advert, each measured from the end of the
+    /// previous one (Total from the scan callback to the end of publishing).
+    enum class Stage : uint8_t {
+        Admit,   ///< scan callback -> queued (scan response merge, filter, dedup)
+        Queue,   ///< queued -> dequeued by process() or a worker
+        Decode,  ///< dequeued -> decoded into JSON
+        Output,  ///< decoded -> handed to the handler (worker output queue wait)
+        Publish, ///< handler call (e.g. the MQTT send)
+        Total,   ///< scan callback -> handler returned
+    };
+    static constexpr size_t STAGE_COUNT = 6;
+
+    /// Occupancy histogram resolution: bucket i counts sends that left a
+    /// queue between i and i + 1 tenths full.
+    static constexpr size_t OCCUPANCY_BUCKETS = 10;
+
     /// Initialize and start the BLE scanning RTOS task.
-    /// Idempotent — second call is a no-op.
+    /// Idempotent — second call is a no-op. If the queues cannot be
+    /// allocated it logs the failure and the scanner stays stopped.
     void begin(size_t ringBufSize = 2048,
                uint32_t scanTimeMs = 15000,
                uint16_t scanInterval = 100,
                uint16_t scanWindow = 99,
                uint32_t taskStackSize = 4096,
                UBaseType_t taskPriority = 1,
-               UBaseType_t ringBufCap = MALLOC_CAP_DEFAULT);
+               UBaseType_t ringBufCap = MALLOC_CAP_DEFAULT,
+               QueueType queueType = QueueType::RingBuffer);
+
+    /// Push one advert through the same path as the scan callback (merge,
+    /// filter, dedup, lanes, queue). For replaying captures and for host
+    /// builds, where there is no radio; must not run concurrently with
+    /// the scan callback or another injectAdvert(). Ignored before begin().
+    /// flags are the ADV_FLAG_SCANNABLE / ADV_FLAG_SCAN_RSP bits of
+    /// advrecord.hpp that the scan callback derives from the GAP event type.
+    void injectAdvert(const uint8_t mac[6], int8_t rssi, const uint8_t *ad, size_t adLen,
+                      uint8_t flags = 0);
 
     /// Drain one item from the ring buffer, decode and populate doc.
     /// mac is filled with the colon-stripped uppercase MAC (e.g. "AABBCCDDEEFF").
+    /// doc["ts"] is the scan callback time in microseconds since boot.
     /// Returns true if an item was processed, false if queue was empty.
+    /// With setRawUnknown(false), undecoded items are consumed silently, so
+    /// one call may take several; processBatch() bounds that work.
     bool process(JsonDocument &doc, char *mac, size_t macLen);
 
-    /// Set BTHome decryption key (32-char hex string). Empty disables decryption.
+    /// Receives one decoded advert; doc and mac are only valid during the call.
+    using Handler = std::function<void(JsonDocument &doc, const char *mac)>;
+
+    /// Drain up to maxItems queued adverts, stopping early once maxMicros have
+    /// elapsed (0 = no time limit) or the queue is empty. One document is
+    /// reused for the whole batch and handed to handler for each advert.
+    /// Returns the number of queue items taken; undecoded adverts consumed
+    /// silently and malformed items count against maxItems as well.
+    size_t processBatch(size_t maxItems, uint32_t maxMicros, const Handler &handler);
+
+    /// Decode on `count` worker tasks instead of in process(). Adverts are
+    /// sharded by MAC, so each device is always handled by the same worker
+    /// and its adverts stay in order. Each worker gets its own ring buffer of
+    /// ringBufSize bytes; results are queued as JSON text for drainOutput().
+    /// core < 0 leaves the workers unpinned. Workers run as std::thread,
+    /// configured through esp_pthread. Call before begin().
+    void setWorkers(uint8_t count, int core = -1, uint32_t stackSize = 6144,
+                    UBaseType_t priority = 1);
+
+    /// Receives one worker result; all pointers are only valid during the call.
+    using OutputHandler = std::function<void(const char *mac, const char *json, size_t len)>;
+
+    /// Worker mode counterpart of processBatch(): hand up to maxItems decoded
+    /// results to handler, stopping early after maxMicros (0 = no limit).
+    /// Returns the number of results handled.
+    size_t drainOutput(size_t maxItems, uint32_t maxMicros, const OutputHandler &handler);
+
+    /// Tag every `every`th queued advert with a trace ID (0 disables, the
+    /// default). Traced adverts carry "trace": {"id", "enq", "deq"}, the
+    /// last two in microseconds after "ts". Call before begin().
+    void setTraceSampling(uint32_t every);
+
+    /// Set the BTHome decryption key (32-char hex string) for devices
+    /// without their own key in bthomeKeys(). Empty disables it.
     void setBTHomeKey(const char *hexKey);
 
+    /// Per-device BTHome keys, each with a cached AES-CCM context. Fill it
+    /// before begin(), e.g. with loadNvs() or loadFile(); keys may also be
+    /// added later. Hit, miss and failure counts are in its stats().
+    BTHomeKeyStore *bthomeKeys();
+
     /// Enable or disable active scanning. Call before begin().
     void setActiveScan(bool active);
 
-    /// Ring buffer and queue statistics.
+    /// Scan continuously instead of in scanTimeMs windows: one scan is
+    /// started and only restarted if the stack ends it, so there is no
+    /// reception gap between windows. Call before begin().
+    void setContinuousScan(bool continuous);
+
+    /// With active scanning, hold each advert for up to timeoutMs so its
+    /// scan response can be merged into the same record (see ScanMerge.h).
+    /// slots bounds the adverts held at once; timeoutMs == 0 disables
+    /// merging. Defaults to 100 ms / 16 slots. Call before begin().
+    void setScanResponseMerge(uint32_t timeoutMs, size_t slots = 16);
+
+    /// Size of the internal SRAM front ring of each QueueType::Tiered queue
+    /// (default 2048, at most ringBufSize); ringBufSize/ringBufCap size the
+    /// spill ring behind it. If the tiers cannot be allocated the queue is a
+    /// plain ring buffer instead. Call before begin().
+    void setFastTierSize(size_t bytes);
+
+    /// Give undecodable adverts their own bounded queue of ringBufSize bytes
+    /// per consumer (0 = single lane, the default). With QueueType::Tiered
+    /// this lane is a plain ring buffer in ringBufCap memory. Call before
+    /// begin().
+    void setLowPriorityLane(size_t ringBufSize);
+
+    /// Publish adverts no decoder matched one by one as raw JSON (default).
+    /// When off, they only update the device table and are reported in
+    /// aggregate by unknownSummary(). Call before begin().
+    void setRawUnknown(bool publish);
+
+    /// Select the queue overload policy. coalesceSlots sizes the slot table
+    /// for CoalesceByMac (roughly the number of devices that can be pending
+    /// at once). Call before begin().
+    void setOverloadPolicy(OverloadPolicy policy, size_t coalesceSlots = 64);
+
+    /// Suppress byte-identical adverts from a device seen again within
+    /// windowMs (0 disables). An unchanged device is still emitted every
+    /// reemitMs (default 30 s) so liveness checks keep working; 0 never
+    /// re-emits, so a device that stops changing goes silent. cacheSize
+    /// bounds the number of devices tracked. Call before begin().
+    void setDedup(uint32_t windowMs, uint32_t reemitMs = 30000, size_t cacheSize = 256);
+
+    /// Install the rule set applied in the scan callback before an advert is
+    /// queued (see AdvFilter.h). The filter is copied; may be called before
+    /// begin() or at any time later to replace the active rules. An empty
+    /// filter disables filtering.
+    void setFilter(const AdvFilter &filter);
+
+    /// Hit counts of the active filter's rules, see AdvFilter::ruleHits().
+    /// The counts start at zero with each setFilter(). Returns the number of
+    /// rules copied to out; 0 without a filter.
+    size_t filterHits(AdvFilter::RuleHits *out, size_t maxRules) const;
+
+    /// Keep the latest state of up to `capacity` devices in a DeviceTable
+    /// (allocated from `caps`), updated as records are decoded. Call before
+    /// begin().
+    void setDeviceTable(size_t capacity, UBaseType_t caps = MALLOC_CAP_SPIRAM);
+
+    /// The device table, or nullptr if setDeviceTable() was not called.
+    DeviceTable *devices();
+
+    /// Hand every decoded advert to `sink` as a typed Measurement, on the
+    /// decoding task and before it is turned into JSON (e.g. for the UI).
+    /// The sink must outlive the scanner. Call before begin().
+    void setMeasurementSink(MeasurementSink *sink);
+
+    /// Ring buffer and queue statistics. Counters are cumulative since
+    /// begin(); each group of them (enqueue side, loop consumer, each
+    /// worker) is copied consistently, never halfway through an update.
     struct Stats {
+        uint64_t timeUs;      ///< When the snapshot was taken (esp_timer)
         size_t hwmBytes;      ///< High water mark (peak bytes used)
         size_t totalBytes;    ///< Ring buffer total capacity
         uint8_t hwmPercent;   ///< High water mark as percentage of total
         uint32_t queueFull;   ///< Times send_complete failed (queue full)
         uint32_t acquireFail; ///< Times send_acquire failed (no space)
+        uint32_t queued;      ///< Adverts accepted into a lane (all lanes)
         uint32_t received;    ///< Total messages dequeued
         uint32_t decoded;     ///< Messages matched by a decoder
+        uint32_t filterMac;        ///< Dropped by a MAC deny rule
+        uint32_t filterCompany;    ///< Dropped by a company ID deny rule
+        uint32_t filterUuid;       ///< Dropped by a service UUID deny rule
+        uint32_t filterNotAllowed; ///< Dropped for matching no allow rule
+        uint32_t suppressed;  ///< Identical repeats dropped by dedup
+        uint32_t reemitted;   ///< Identical repeats forced out by re-emit interval
+        uint32_t evicted;     ///< DropOldest: queued adverts evicted for newer ones
+        uint32_t coalesced;   ///< CoalesceByMac: pending adverts overwritten in place
+        uint32_t coalesceFull; ///< CoalesceByMac: no free slot, queued as a full record
+        uint32_t spilledItems; ///< Tiered: adverts that went to the spill ring
+        uint64_t spilledBytes; ///< Tiered: bytes that went to the spill ring
+        size_t spillHwmBytes; ///< Tiered: fullest spill ring high water mark
+        uint32_t scanMerged;  ///< Adverts merged with their scan response
+        uint32_t scanUnmatched; ///< Held adverts sent on without a response
+        uint32_t scanRestarts; ///< Scans started after the first one
+        uint32_t maxGapMs;    ///< Longest time between two scan callbacks
+        size_t heapFree;      ///< Internal heap free now
+        size_t heapMinFree;   ///< Internal heap low water mark since boot
+        /// Queue fill level after each successful send, summed over all
+        /// queues; shows how much of the buffer bursts actually use.
+        uint32_t occupancy[OCCUPANCY_BUCKETS];
     };
 
-    /// Return current ring buffer statistics.
+    /// Return current ring buffer statistics. In worker mode the ring buffer
+    /// figures are those of the fullest worker queue.
     Stats stats() const;
 
+    /// Per second rates between two stats() snapshots.
+    struct Rates {
+        float queued;     ///< Adverts accepted into the queues
+        float received;   ///< Adverts dequeued
+        float decoded;    ///< Adverts matched by a decoder
+        float dropped;    ///< Lost to a full queue (acquireFail, queueFull,
+                          ///< evicted)
+        float filtered;   ///< Rejected by the filter
+        float suppressed; ///< Removed by dedup
+    };
+
+    static Rates rates(const Stats &prev, const Stats &now);
+
+    /// Fill doc with one summary of the devices no decoder has matched:
+    /// {"count", "adverts", "devices": [{mac, n, rmin, rmax, first, last,
+    /// cid, name}]}, listing at most maxDevices, most recently seen first.
+    /// first and last are microseconds since boot, like "ts" on adverts.
+    /// Needs setDeviceTable(). Returns the number of unknown devices.
+    size_t unknownSummary(JsonDocument &doc, size_t maxDevices = 64);
+
+    /// Per lane statistics, summed over all consumers.
+    struct LaneStats {
+        uint32_t queued;      ///< Adverts accepted into the lane
+        uint32_t dropped;     ///< Adverts lost to a full lane
+        size_t queueBytes;    ///< Bytes currently queued
+        size_t hwmBytes;      ///< High water mark
+        size_t totalBytes;    ///< Capacity (0 if the lane does not exist)
+    };
+
+    LaneStats laneStats(Lane lane) const;
+
+    /// Latency of one stage, in microseconds, over a window.
+    struct LatencyStats {
+        uint32_t count;
+        uint32_t p50Us;       ///< within 25%, see latency.hpp
+        uint32_t p99Us;
+        uint32_t maxUs;
+    };
+
+    /// Latency since the last call with reset (or since begin()). Output,
+    /// Publish and Total are only measured by processBatch() and
+    /// drainOutput(), which see the handler run.
+    LatencyStats latency(Stage stage, bool reset = true);
+
+    /// Per decode worker statistics.
+    struct WorkerStats {
+        uint32_t processed;   ///< Records decoded by this worker
+        uint32_t decoded;     ///< Records matched by a decoder
+        uint32_t outputDrops; ///< Results lost because the output queue was full
+        uint8_t utilization;  ///< Percent of time spent decoding since start
+        size_t queueBytes;    ///< Current input queue usage
+        size_t hwmBytes;      ///< Input queue high water mark
+    };
+
+    /// Number of running decode workers (0 unless setWorkers() was used).
+    size_t workerCount() const;
+    WorkerStats workerStats(size_t idx) const;
+
 private:
     BLEScanner() = default;
 
     Impl *_impl = nullptr;
     bool _started = false;
 
-    bool deliver(JsonDocument &rawDoc, JsonDocument &outDoc);
+    bool deliver(const AdvView &adv, Measurement &out);
+    bool decodeRecord(const AdvRecord *rec, JsonDocument &doc, char *mac, size_t macLen);
+    bool processOne(JsonDocument &doc, char *mac, size_t macLen,
+                    uint64_t &timeUs, int64_t &decodedUs, bool &publish);
+    void workerLoop(size_t idx);
 };
@@ -0,0 +1,110 @@
+#include "CoalesceTable.h"
+
+#include <cstring>
+#include <thread>
+
+CoalesceTable::~CoalesceTable() {
+    delete[] _slots;
+}
+
+bool CoalesceTable::create(size_t slots) {
+    size_t n = PROBE;
+    while (n < slots)
+        n <<= 1;
+    delete[] _slots;
+    _slots = new Slot[n];
+    _mask = n - 1;
+    return true;
+}
+
+void CoalesceTable::store(Slot &slot, const AdvRecord &hdr, const uint8_t *ad) {
+    memcpy(slot.data, &hdr, sizeof(AdvRecord));
+    memcpy(slot.data + sizeof(AdvRecord), ad, hdr.adLen);
+    slot.len = (uint16_t)hdr.size();
+}
+
+CoalesceTable::Result CoalesceTable::put(const AdvRecord &hdr, const uint8_t *ad,
+                                         uint16_t *index) {
+    if (!_slots || hdr.size() > SLOT_SIZE)
+        return FULL;
+
+    uint64_t mac = macKey(hdr.mac);
+    size_t start = probeStart(mac);
+    Slot *freeSlot = nullptr;
+
+    for (size_t i = 0; i < PROBE; i++) {
+        size_t idx = (start + i) & _mask;
+        Slot &slot = _slots[idx];
+        uint8_t state = slot.state.load(std::memory_order_acquire);
+        if (state == PENDING && slot.mac == mac) {
+            uint8_t expected = PENDING;
+            if (slot.state.compare_exchange_strong(expected, WRITING,
+                                                   std::memory_order_acquire)) {
+                store(slot, hdr, ad);
+                slot.state.store(PENDING, std::memory_order_release);
+                return COALESCED;
+            }
+            // the consumer just started reading it; fall back to a new slot
+        } else if (state == FREE && !freeSlot) {
+            freeSlot = &slot;
+            *index = (uint16_t)idx;
+        }
+    }
+
+    if (!freeSlot)
+        return FULL;
+
+    // only the producer moves a slot out of FREE, so no CAS is needed
+    freeSlot->state.store(WRITING, std::memory_order_relaxed);
+    freeSlot->mac = mac;
+    store(*freeSlot, hdr, ad);
+    freeSlot->state.store(PENDING, std::memory_order_release);
+    return CLAIMED;
+}
+
+void CoalesceTable::cancel(uint16_t index) {
+    _slots[index & _mask].state.store(FREE, std::memory_order_release);
+}
+
+bool CoalesceTable::drop(const uint8_t mac[6]) {
+    if (!_slots)
+        return false;
+    uint64_t key = macKey(mac);
+    size_t start = probeStart(key);
+    for (size_t i = 0; i < PROBE; i++) {
+        Slot &slot = _slots[(start + i) & _mask];
+        if (slot.state.load(std::memory_order_acquire) != PENDING || slot.mac != key)
+            continue;
+        // a failed CAS means the consumer is already reading it
+        uint8_t expected = PENDING;
+        return slot.state.compare_exchange_strong(expected, DROPPED,
+                                                  std::memory_order_relaxed);
+    }
+    return false;
+}
+
+size_t CoalesceTable::take(uint16_t index, uint8_t *out) {
+    if (!_slots || index > _mask)
+        return 0;
+    Slot &slot = _slots[index];
+
+    uint8_t expected = PENDING;
+    while (!slot.state.compare_exchange_weak(expected, READING,
+                                             std::memory_order_acquire)) {
+        if (expected == DROPPED) {
+            // only this index refers to it, so no CAS is needed
+            slot.state.store(FREE, std::memory_order_release);
+            return 0;
+        }
+        if (expected != WRITING && expected != PENDING)
+            return 0;
+        // the producer is mid-overwrite; it never blocks, so this is short
+        expected = PENDING;
+        std::this_thread::yield();
+    }
+
+    size_t len = slot.len;
+    memcpy(out, slot.data, len);
+    slot.state.store(FREE, std::memory_order_release);
+    return len;
+}
@@ -0,0 +1,82 @@
+/// @file CoalesceTable.h
+/// @brief Latest-pending-advert-per-device slot table for the coalesce overload policy.
+///
+/// Instead of queueing every advert, the scan callback stores it in a slot
+/// keyed by MAC and queues only the 2-byte slot index. While that index is
+/// still waiting in the queue, further adverts from the same device overwrite
+/// the slot in place, so the queue never holds two entries for one device and
+/// the consumer always sees the freshest data.
+///
+/// Slot states move FREE -> WRITING -> PENDING (producer), PENDING -> WRITING
+/// -> PENDING (producer, coalescing), PENDING -> DROPPED (producer,
+/// invalidating), PENDING -> READING -> FREE and DROPPED -> FREE (consumer).
+/// Transitions out of PENDING are compare-and-swap, so a slot is never
+/// written while it is being read. Single producer; each slot index is
+/// consumed by whoever dequeues it.
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "advrecord.hpp"
+
+class CoalesceTable {
+public:
+    /// Largest record (header + AD bytes) a slot holds; bigger adverts
+    /// bypass coalescing.
+    static constexpr size_t SLOT_SIZE = 128;
+
+    enum Result : uint8_t {
+        COALESCED, ///< overwrote the device's pending slot; nothing to queue
+        CLAIMED,   ///< stored in a free slot; queue *index or cancel() it
+        FULL,      ///< no pending or free slot in the probe window
+    };
+
+    CoalesceTable() = default;
+    ~CoalesceTable();
+    CoalesceTable(const CoalesceTable &) = delete;
+    CoalesceTable &operator=(const CoalesceTable &) = delete;
+
+    /// Allocate `slots` slots (rounded up to a power of two).
+    bool create(size_t slots);
+
+    /// Producer: store the record `hdr` + `ad` for hdr.mac.
+    Result put(const AdvRecord &hdr, const uint8_t *ad, uint16_t *index);
+
+    /// Producer: release a CLAIMED slot whose index could not be queued.
+    void cancel(uint16_t index);
+
+    /// Producer: invalidate the pending slot of `mac`, if any, after one of
+    /// its adverts was queued without the table (put() returned FULL), so
+    /// later adverts cannot coalesce into the older record and overtake the
+    /// queued one. The slot's queued index then takes nothing. Returns true
+    /// if a slot was invalidated.
+    bool drop(const uint8_t mac[6]);
+
+    /// Consumer: copy the slot's record into out (SLOT_SIZE bytes) and free
+    /// it. Returns the record size, or 0 for an invalid index or a dropped
+    /// slot.
+    size_t take(uint16_t index, uint8_t *out);
+
+private:
+    static constexpr size_t PROBE = 8;
+
+    enum State : uint8_t { FREE, WRITING, PENDING, READING, DROPPED };
+
+    struct Slot {
+        std::atomic<uint8_t> state{FREE};
+        uint16_t len = 0;
+        uint64_t mac = 0;
+        alignas(8) uint8_t data[SLOT_SIZE];
+    };
+
+    Slot *_slots = nullptr;
+    size_t _mask = 0;
+
+    void store(Slot &slot, const AdvRecord &hdr, const uint8_t *ad);
+
+    static size_t probeStart(uint64_t mac) {
+        return (size_t)((mac * 0x9E3779B97F4A7C15ull) >> 32);
+    }
+};
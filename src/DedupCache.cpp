@@ -0,0 +1,85 @@
+#include "DedupCache.h"
+
+static constexpr uint64_t EMPTY_MAC = ~0ull;
+
+// FNV-1a over the AD payload; RSSI and timestamps are not part of it.
+static uint32_t payloadHash(const uint8_t *data, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static inline size_t bucketOf(uint64_t mac) {
+    return (size_t)((mac * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+DedupCache::~DedupCache() {
+    delete[] _entries;
+}
+
+bool DedupCache::create(size_t entries, uint32_t windowMs, uint32_t reemitMs) {
+    size_t buckets = 1;
+    while (buckets * WAYS < entries)
+        buckets <<= 1;
+
+    delete[] _entries;
+    _entries = new Entry[buckets * WAYS];
+    for (size_t i = 0; i < buckets * WAYS; i++)
+        _entries[i].mac = EMPTY_MAC;
+    _bucketMask = buckets - 1;
+    _windowMs = windowMs;
+    _reemitMs = reemitMs;
+    return true;
+}
+
+DedupCache::Result DedupCache::check(uint64_t mac, const uint8_t *ad, size_t len,
+                                     uint32_t nowMs) {
+    if (!_entries)
+        return EMIT;
+
+    uint32_t hash = payloadHash(ad, len);
+    Entry *bucket = &_entries[(bucketOf(mac) & _bucketMask) * WAYS];
+    Entry *victim = &bucket[0];
+
+    for (size_t i = 0; i < WAYS; i++) {
+        Entry &e = bucket[i];
+        if (e.mac == mac) {
+            bool same = e.hash == hash && nowMs - e.lastSeenMs < _windowMs;
+            e.lastSeenMs = nowMs;
+            if (!same) {
+                e.hash = hash;
+                e.lastEmitMs = nowMs;
+                return EMIT;
+            }
+            if (_reemitMs && nowMs - e.lastEmitMs >= _reemitMs) {
+                e.lastEmitMs = nowMs;
+                return REEMIT;
+            }
+            return SUPPRESS;
+        }
+        if (victim->mac != EMPTY_MAC &&
+                (e.mac == EMPTY_MAC || nowMs - e.lastSeenMs > nowMs - victim->lastSeenMs))
+            victim = &e;
+    }
+
+    victim->mac = mac;
+    victim->hash = hash;
+    victim->lastSeenMs = nowMs;
+    victim->lastEmitMs = nowMs;
+    return EMIT;
+}
+
+void DedupCache::forget(uint64_t mac) {
+    if (!_entries)
+        return;
+    Entry *bucket = &_entries[(bucketOf(mac) & _bucketMask) * WAYS];
+    for (size_t i = 0; i < WAYS; i++) {
+        if (bucket[i].mac == mac) {
+            bucket[i].mac = EMPTY_MAC;
+            return;
+        }
+    }
+}
@@ -0,0 +1,56 @@
+/// @file DedupCache.h
+/// @brief Per-MAC payload hash cache used to suppress repeated adverts.
+///
+/// Many sensors repeat an unchanged advert several times per second. The
+/// cache remembers a hash of the last AD payload per device; a byte-identical
+/// advert seen again within the window is suppressed, unless the device has
+/// not been emitted for the re-emit interval (so downstream liveness checks
+/// keep working).
+///
+/// The table is 4-way set associative: a lookup probes one bucket of four
+/// slots and a miss replaces the least recently seen slot, so both cost O(1)
+/// and memory is bounded. Not thread safe - owned by the scan callback.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+class DedupCache {
+public:
+    enum Result : uint8_t {
+        EMIT,     ///< new device or changed payload
+        SUPPRESS, ///< identical payload within the window
+        REEMIT,   ///< identical payload, forced out by the re-emit interval
+    };
+
+    DedupCache() = default;
+    ~DedupCache();
+    DedupCache(const DedupCache &) = delete;
+    DedupCache &operator=(const DedupCache &) = delete;
+
+    /// Allocate room for about `entries` devices (rounded up to a power of
+    /// two). reemitMs == 0 disables forced re-emission.
+    bool create(size_t entries, uint32_t windowMs, uint32_t reemitMs);
+
+    /// Classify an advert from `mac` (see macKey()) with AD payload `ad`.
+    Result check(uint64_t mac, const uint8_t *ad, size_t len, uint32_t nowMs);
+
+    /// Drop what is remembered about `mac`, so its next advert is emitted.
+    /// For an advert check() let through that could not be queued.
+    void forget(uint64_t mac);
+
+private:
+    static constexpr size_t WAYS = 4;
+
+    struct Entry {
+        uint64_t mac;
+        uint32_t hash;
+        uint32_t lastSeenMs;
+        uint32_t lastEmitMs;
+    };
+
+    Entry *_entries = nullptr;
+    size_t _bucketMask = 0;
+    uint32_t _windowMs = 0;
+    uint32_t _reemitMs = 0;
+};
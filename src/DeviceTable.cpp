@@ -0,0 +1,339 @@
+#include "DeviceTable.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef ESP_PLATFORM
+    #include "esp_heap_caps.h"
+#endif
+
+#include "advrecord.hpp"
+#include "measurement.hpp"
+
+static void copyString(char *dst, size_t dstLen, const char *src, size_t srcLen) {
+    size_t n = srcLen < dstLen - 1 ? srcLen : dstLen - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+}
+
+const DeviceField *DeviceInfo::field(const char *key) const {
+    for (size_t i = 0; i < fieldCount; i++)
+        if (strncmp(fields[i].key, key, DEVICE_KEY_LEN) == 0)
+            return &fields[i];
+    return nullptr;
+}
+
+float DeviceInfo::rate(uint64_t nowUs) const {
+    if (adverts < 2)
+        return 0.0f;
+    float interval = intervalUs;
+    float silent = nowUs > lastSeenUs ? (float)(nowUs - lastSeenUs) : 0.0f;
+    if (silent > interval)
+        interval = silent;
+    return interval > 0.0f ? 1.0e6f / interval : 0.0f;
+}
+
+float DeviceInfo::decodeRatio() const {
+    return adverts ? (float)decoded / adverts : 0.0f;
+}
+
+float DeviceInfo::lossRatio(uint32_t periodMs) const {
+    if (!periodMs || adverts < 2)
+        return 0.0f;
+    float expected = (float)(lastSeenUs - firstSeenUs) / (periodMs * 1000.0f) + 1.0f;
+    float loss = 1.0f - adverts / expected;
+    return loss > 0.0f ? loss : 0.0f;
+}
+
+// EWMA weight for interval and RSSI statistics
+static constexpr float STATS_ALPHA = 1.0f / 8;
+
+static size_t intervalBucket(uint64_t intervalUs) {
+    uint32_t units = (uint32_t)std::min<uint64_t>(intervalUs / 64000, UINT32_MAX);
+    size_t b = 0;
+    while (units && b < DEVICE_INTERVAL_BUCKETS - 1) {
+        units >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static void updateStats(DeviceInfo &info, const AdvRecord *rec) {
+    float rssi = rec->rssi;
+    if (info.adverts == 0) {
+        info.rssiMean = rssi;
+        info.rssiVar = 0.0f;
+        return;
+    }
+
+    // exponentially weighted mean and variance (West 1979)
+    float diff = rssi - info.rssiMean;
+    float incr = STATS_ALPHA * diff;
+    info.rssiMean += incr;
+    info.rssiVar = (1.0f - STATS_ALPHA) * (info.rssiVar + diff * incr);
+
+    if (rec->timeUs <= info.lastSeenUs)
+        return; // out-of-order record; no interval to measure
+    uint64_t interval = rec->timeUs - info.lastSeenUs;
+    if (info.adverts == 1)
+        info.intervalUs = (float)interval;
+    else
+        info.intervalUs += STATS_ALPHA * ((float)interval - info.intervalUs);
+    info.intervalHist[intervalBucket(interval)]++;
+}
+
+DeviceTable::~DeviceTable() {
+#ifdef ESP_PLATFORM
+    heap_caps_free(_entries);
+#else
+    std::free(_entries);
+#endif
+    delete[] _index;
+    delete[] _order;
+}
+
+bool DeviceTable::create(size_t capacity, uint32_t caps) {
+    if (_entries || capacity == 0 || capacity >= NONE / 2)
+        return false;
+
+#ifdef ESP_PLATFORM
+    _entries = static_cast<Entry *>(heap_caps_calloc(capacity, sizeof(Entry),
+                                    caps ? caps : MALLOC_CAP_DEFAULT));
+#else
+    (void)caps;
+    _entries = static_cast<Entry *>(std::calloc(capacity, sizeof(Entry)));
+#endif
+    if (!_entries)
+        return false;
+
+    // index at most half full keeps probe sequences short
+    size_t slots = 1;
+    while (slots < capacity * 2)
+        slots <<= 1;
+    _index = new uint16_t[slots];
+    for (size_t i = 0; i < slots; i++)
+        _index[i] = NONE;
+    _indexMask = slots - 1;
+    _order = new uint16_t[capacity];
+    _capacity = capacity;
+    return true;
+}
+
+size_t DeviceTable::slotOf(uint64_t key) const {
+    return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & _indexMask;
+}
+
+uint16_t DeviceTable::lookup(uint64_t key) const {
+    for (size_t i = slotOf(key);; i = (i + 1) & _indexMask) {
+        uint16_t e = _index[i];
+        if (e == NONE || _entries[e].key == key)
+            return e;
+    }
+}
+
+void DeviceTable::insertIndex(uint64_t key, uint16_t entry) {
+    size_t i = slotOf(key);
+    while (_index[i] != NONE)
+        i = (i + 1) & _indexMask;
+    _index[i] = entry;
+}
+
+void DeviceTable::eraseIndex(uint64_t key) {
+    size_t i = slotOf(key);
+    while (_index[i] != NONE && _entries[_index[i]].key != key)
+        i = (i + 1) & _indexMask;
+    if (_index[i] == NONE)
+        return;
+
+    // backward shift: pull later members of the probe run into the hole
+    for (size_t j = (i + 1) & _indexMask; _index[j] != NONE; j = (j + 1) & _indexMask) {
+        size_t home = slotOf(_entries[_index[j]].key);
+        bool movable = i <= j ? (home <= i || home > j) : (home <= i && home > j);
+        if (movable) {
+            _index[i] = _index[j];
+            i = j;
+        }
+    }
+    _index[i] = NONE;
+}
+
+void DeviceTable::unlink(uint16_t entry) {
+    Entry &e = _entries[entry];
+    if (e.prev != NONE)
+        _entries[e.prev].next = e.next;
+    else
+        _head[e.list] = e.next;
+    if (e.next != NONE)
+        _entries[e.next].prev = e.prev;
+    else
+        _tail[e.list] = e.prev;
+}
+
+void DeviceTable::pushFront(uint16_t entry, List list) {
+    Entry &e = _entries[entry];
+    e.list = list;
+    e.touched = ++_touch;
+    e.prev = NONE;
+    e.next = _head[list];
+    if (_head[list] != NONE)
+        _entries[_head[list]].prev = entry;
+    _head[list] = entry;
+    if (_tail[list] == NONE)
+        _tail[list] = entry;
+}
+
+uint16_t DeviceTable::acquire(uint64_t key, const uint8_t mac[6], uint64_t nowUs,
+                              bool decoded) {
+    uint16_t entry = lookup(key);
+    if (entry != NONE) {
+        List list = decoded ? DECODED : (List)_entries[entry].list;
+        unlink(entry);
+        pushFront(entry, list);
+        return entry;
+    }
+
+    List list = decoded ? DECODED : UNDECODED;
+    if (_count < _capacity) {
+        entry = (uint16_t)_count++;
+    } else {
+        // evict the least recently seen undecoded device; a decoded one
+        // only gives way to another decoded device
+        List victim = _tail[UNDECODED] != NONE ? UNDECODED : list;
+        entry = _tail[victim];
+        if (entry == NONE) {
+            _skipped++;
+            return NONE;
+        }
+        unlink(entry);
+        eraseIndex(_entries[entry].key);
+        _evictions++;
+    }
+
+    Entry &e = _entries[entry];
+    memset(&e.info, 0, sizeof(e.info));
+    memcpy(e.info.mac, mac, sizeof(e.info.mac));
+    e.info.firstSeenUs = nowUs;
+    e.info.dirty = DEVICE_DIRTY_NEW;
+    e.key = key;
+    insertIndex(key, entry);
+    pushFront(entry, list);
+    return entry;
+}
+
+// Collect the numeric fields of a measurement.
+static uint8_t collectFields(const Measurement &m, DeviceField *fields) {
+    uint8_t n = 0;
+    for (size_t i = 0; i < m.count && n < DEVICE_MAX_FIELDS; i++) {
+        float value;
+        if (!m.fields[i].number(value))
+            continue;
+        const char *key = m.fields[i].key;
+        copyString(fields[n].key, DEVICE_KEY_LEN, key, strlen(key));
+        fields[n].value = value;
+        n++;
+    }
+    return n;
+}
+
+void DeviceTable::update(const AdvView &adv, const Measurement &m, bool decoded) {
+    if (!_entries)
+        return;
+    const AdvRecord *rec = adv.rec;
+
+    // build the new field set outside the lock
+    DeviceField fields[DEVICE_MAX_FIELDS] = {};
+    uint8_t fieldCount = decoded ? collectFields(m, fields) : 0;
+
+    std::lock_guard<std::mutex> guard(_lock);
+    uint16_t entry = acquire(macKey(rec->mac), rec->mac, rec->timeUs, decoded);
+    if (entry == NONE)
+        return;
+    DeviceInfo &info = _entries[entry].info;
+
+    updateStats(info, rec);
+    info.rssi = rec->rssi;
+    if (info.adverts == 0 || rec->rssi < info.rssiMin)
+        info.rssiMin = rec->rssi;
+    if (info.adverts == 0 || rec->rssi > info.rssiMax)
+        info.rssiMax = rec->rssi;
+    if (rec->timeUs > info.lastSeenUs)
+        info.lastSeenUs = rec->timeUs;
+    info.adverts++;
+    info.dirty |= DEVICE_DIRTY_SEEN;
+    if (!adv.name.empty())
+        copyString(info.name, sizeof(info.name), (const char *)adv.name.data(),
+                   adv.name.size());
+    if (adv.mfd.size() >= 2) {
+        info.companyId = adv.mfd[0] | (adv.mfd[1] << 8);
+        info.hasCompany = true;
+    }
+
+    if (!decoded)
+        return;
+    info.decoded++;
+    if (m.dev)
+        copyString(info.dev, sizeof(info.dev), m.dev, strlen(m.dev));
+    else
+        info.dev[0] = '\0';
+    if (fieldCount != info.fieldCount ||
+            memcmp(fields, info.fields, fieldCount * sizeof(DeviceField)) != 0) {
+        memcpy(info.fields, fields, fieldCount * sizeof(DeviceField));
+        info.fieldCount = fieldCount;
+        info.dirty |= DEVICE_DIRTY_DATA;
+    }
+}
+
+bool DeviceTable::find(const uint8_t mac[6], DeviceInfo &out) const {
+    if (!_entries)
+        return false;
+    std::lock_guard<std::mutex> guard(_lock);
+    uint16_t entry = lookup(macKey(mac));
+    if (entry == NONE)
+        return false;
+    out = _entries[entry].info;
+    return true;
+}
+
+size_t DeviceTable::snapshot(DeviceInfo *out, size_t max,
+                             bool dirtyOnly, bool clearDirty) {
+    if (!_entries || !max)
+        return 0;
+    std::lock_guard<std::mutex> guard(_lock);
+    size_t n = 0;
+    walk([&](uint16_t e) {
+        DeviceInfo &info = _entries[e].info;
+        if (dirtyOnly && !info.dirty)
+            return true;
+        out[n++] = info;
+        if (clearDirty)
+            info.dirty = 0;
+        return n < max;
+    });
+    return n;
+}
+
+size_t DeviceTable::topTalkers(DeviceInfo *out, size_t max, uint64_t nowUs) const {
+    if (!_entries || !max)
+        return 0;
+
+    // rank entry numbers first so only the winners are copied
+    std::lock_guard<std::mutex> guard(_lock);
+    uint16_t *order = _order;
+    size_t n = 0;
+    for (uint16_t head : _head)
+        for (uint16_t e = head; e != NONE; e = _entries[e].next)
+            order[n++] = e;
+    size_t k = std::min(n, max);
+    std::partial_sort(order, order + k, order + n, [&](uint16_t a, uint16_t b) {
+        return _entries[a].info.rate(nowUs) > _entries[b].info.rate(nowUs);
+    });
+    for (size_t i = 0; i < k; i++)
+        out[i] = _entries[order[i]].info;
+    return k;
+}
+
+size_t DeviceTable::size() const {
+    std::lock_guard<std::mutex> guard(_lock);
+    return _count;
+}
@@ -0,0 +1,199 @@
+/// @file DeviceTable.h
+/// @brief Fixed-capacity latest-value table of seen devices, keyed by MAC.
+///
+/// Keeps one DeviceInfo per device with the last decoded measurements,
+/// first/last seen time, RSSI and dirty flags, so the UI or a new MQTT
+/// subscriber can read current state instead of waiting for the next advert.
+/// Each entry also carries reception statistics (advert rate, inter-arrival
+/// histogram, RSSI mean/variance, decode ratio), updated in O(1) per advert.
+/// They count adverts that reach the decode side, i.e. after filtering,
+/// dedup and overload drops; disable dedup when estimating beacon loss.
+///
+/// Entries live in one block (PSRAM by default) and are found through an
+/// open-addressing index of 16-bit entry numbers (linear probing, backward
+/// shift delete). Two intrusive doubly-linked lists keep entries in recency
+/// order, one for devices a decoder has matched and one for the rest. When
+/// the table is full the least recently seen undecoded device is evicted; a
+/// decoded device is only evicted to make room for another decoded one, so
+/// a crowd of undecodable devices (rotating random MACs) cannot push the
+/// known sensors out. An undecoded device arriving at a table full of
+/// decoded ones is not tracked (see skipped()).
+///
+/// update() is called by the decode side (process() or the decode workers),
+/// never by the scan callback, so readers taking the table lock for find()
+/// or snapshot() can delay decoding but never the BLE producer.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+struct AdvView;
+struct Measurement;
+
+static constexpr size_t DEVICE_MAX_FIELDS = 12;
+static constexpr size_t DEVICE_KEY_LEN = 16;
+static constexpr size_t DEVICE_NAME_LEN = 24;
+
+/// Inter-arrival histogram: bucket 0 counts intervals below 64 ms, bucket i
+/// intervals in [32 << i, 64 << i) ms, the last bucket everything longer.
+static constexpr size_t DEVICE_INTERVAL_BUCKETS = 12;
+
+/// Dirty flags, set by update() and cleared by snapshot(..., clearDirty).
+enum : uint8_t {
+    DEVICE_DIRTY_NEW  = 0x01, ///< first advert since the entry was created
+    DEVICE_DIRTY_DATA = 0x02, ///< decoded measurements changed
+    DEVICE_DIRTY_SEEN = 0x04, ///< new advert (RSSI / last seen updated)
+};
+
+/// One numeric measurement, named as in the published JSON.
+struct DeviceField {
+    char key[DEVICE_KEY_LEN];
+    float value;
+};
+
+struct DeviceInfo {
+    uint8_t mac[6];
+    int8_t rssi;
+    uint8_t dirty;
+    int8_t rssiMin;
+    int8_t rssiMax;
+    bool hasCompany;
+    uint16_t companyId;              ///< from manufacturer data, if hasCompany
+    uint64_t firstSeenUs;
+    uint64_t lastSeenUs;
+    uint32_t adverts;                ///< adverts seen since the entry was created
+    uint32_t decoded;                ///< of those, matched by a decoder
+    char dev[DEVICE_KEY_LEN];        ///< decoder "dev" tag, empty if undecoded
+    char name[DEVICE_NAME_LEN];      ///< advertised local name, may be truncated
+    uint8_t fieldCount;
+    DeviceField fields[DEVICE_MAX_FIELDS];
+
+    // reception statistics
+    float intervalUs;                ///< EWMA of the inter-arrival time
+    float rssiMean;                  ///< EWMA of RSSI (dBm)
+    float rssiVar;                   ///< exponentially weighted RSSI variance
+    uint32_t intervalHist[DEVICE_INTERVAL_BUCKETS];
+
+    /// Measurement by key, or nullptr.
+    const DeviceField *field(const char *key) const;
+
+    /// Adverts per second. A device that has gone quiet decays towards zero
+    /// because the silence since lastSeenUs counts as the current interval.
+    float rate(uint64_t nowUs) const;
+
+    /// Fraction of adverts decoded.
+    float decodeRatio() const;
+
+    /// Estimated fraction of adverts lost, given the beacon's advertising
+    /// period: 1 - received / expected over the time the device was seen.
+    float lossRatio(uint32_t periodMs) const;
+};
+
+class DeviceTable {
+public:
+    DeviceTable() = default;
+    ~DeviceTable();
+    DeviceTable(const DeviceTable &) = delete;
+    DeviceTable &operator=(const DeviceTable &) = delete;
+
+    /// Allocate room for `capacity` devices (max 32767). caps selects the
+    /// heap on ESP-IDF (MALLOC_CAP_*), ignored elsewhere.
+    bool create(size_t capacity, uint32_t caps);
+
+    /// Record an advert and what its decoder produced. Numeric
+    /// measurement fields (BTHome objects included) become fields.
+    void update(const AdvView &adv, const Measurement &m, bool decoded);
+
+    /// Copy the entry for `mac`. Returns false if the device is unknown.
+    bool find(const uint8_t mac[6], DeviceInfo &out) const;
+
+    /// Copy up to `max` entries, most recently seen first, taken under one
+    /// lock so the set is consistent. dirtyOnly skips entries with no dirty
+    /// flag set; clearDirty clears the flags of the copied entries.
+    size_t snapshot(DeviceInfo *out, size_t max,
+                    bool dirtyOnly = false, bool clearDirty = false);
+
+    /// Copy the `max` devices with the highest rate(nowUs), highest first.
+    size_t topTalkers(DeviceInfo *out, size_t max, uint64_t nowUs) const;
+
+    /// Call fn(const DeviceInfo &) for every entry, most recently seen first,
+    /// with the table locked. fn must not call back into the table.
+    template <typename F>
+    void forEach(F &&fn) const {
+        if (!_entries)
+            return;
+        std::lock_guard<std::mutex> guard(_lock);
+        walk([&](uint16_t e) {
+            fn(_entries[e].info);
+            return true;
+        });
+    }
+
+    size_t size() const;
+    size_t capacity() const {
+        return _capacity;
+    }
+    uint32_t evictions() const {
+        return _evictions;
+    }
+    /// Undecoded devices not tracked because every entry held a decoded one.
+    uint32_t skipped() const {
+        return _skipped;
+    }
+
+private:
+    static constexpr uint16_t NONE = 0xFFFF;
+
+    /// Recency lists; an entry moves to DECODED the first time it decodes.
+    enum List : uint8_t { DECODED, UNDECODED, LIST_COUNT };
+
+    struct Entry {
+        DeviceInfo info;
+        uint64_t key;
+        uint32_t touched;    ///< update sequence number, orders the two lists
+        uint16_t prev, next; ///< recency list, head = most recent
+        uint8_t list;
+    };
+
+    Entry *_entries = nullptr;
+    uint16_t *_index = nullptr; ///< entry number per hash slot, NONE if empty
+    uint16_t *_order = nullptr; ///< topTalkers() ranking scratch, one per entry
+    size_t _capacity = 0;
+    size_t _indexMask = 0;
+    size_t _count = 0;
+    uint16_t _head[LIST_COUNT] = {NONE, NONE};
+    uint16_t _tail[LIST_COUNT] = {NONE, NONE};
+    uint32_t _touch = 0;
+    uint32_t _evictions = 0;
+    uint32_t _skipped = 0;
+    mutable std::mutex _lock;
+
+    /// Call fn(entry) for every entry, most recently seen first, merging
+    /// the two lists; stops early when fn returns false. Caller holds _lock.
+    template <typename F>
+    void walk(F &&fn) const {
+        uint16_t a = _head[DECODED], b = _head[UNDECODED];
+        while (a != NONE || b != NONE) {
+            uint16_t e;
+            if (b == NONE || (a != NONE &&
+                              (int32_t)(_entries[a].touched - _entries[b].touched) > 0)) {
+                e = a;
+                a = _entries[a].next;
+            } else {
+                e = b;
+                b = _entries[b].next;
+            }
+            if (!fn(e))
+                return;
+        }
+    }
+
+    size_t slotOf(uint64_t key) const;
+    uint16_t lookup(uint64_t key) const;
+    void insertIndex(uint64_t key, uint16_t entry);
+    void eraseIndex(uint64_t key);
+    void unlink(uint16_t entry);
+    void pushFront(uint16_t entry, List list);
+    uint16_t acquire(uint64_t key, const uint8_t mac[6], uint64_t nowUs, bool decoded);
+};
@@ -0,0 +1,95 @@
+#include "ScanMerge.h"
+
+#include <cstring>
+
+ScanMerge::~ScanMerge() {
+    delete[] _slots;
+}
+
+bool ScanMerge::create(size_t slots, uint32_t timeoutMs) {
+    delete[] _slots;
+    _slots = new Slot[slots]();
+    _count = slots;
+    _timeoutUs = (uint64_t)timeoutMs * 1000;
+    return true;
+}
+
+ScanMerge::Slot *ScanMerge::find(const uint8_t mac[6]) {
+    for (size_t i = 0; i < _count; i++)
+        if (_slots[i].used && memcmp(_slots[i].hdr.mac, mac, 6) == 0)
+            return &_slots[i];
+    return nullptr;
+}
+
+ScanMerge::Slot *ScanMerge::oldest() {
+    Slot *o = &_slots[0];
+    for (size_t i = 0; i < _count; i++) {
+        if (!_slots[i].used)
+            return &_slots[i];
+        if (_slots[i].hdr.timeUs < o->hdr.timeUs)
+            o = &_slots[i];
+    }
+    return o;
+}
+
+void ScanMerge::offer(const AdvRecord &hdr, const uint8_t *ad, Emit emit) {
+    if (!_slots || hdr.adLen > MAX_PART) {
+        emit(hdr, ad);
+        return;
+    }
+
+    Slot *held = find(hdr.mac);
+    if ((hdr.flags & ADV_FLAG_SCAN_RSP) && held) {
+        // append the response's AD elements to the held advert
+        memcpy(held->ad + held->hdr.adLen, ad, hdr.adLen);
+        held->hdr.adLen += hdr.adLen;
+        if (!(held->hdr.flags & ADV_FLAG_TXPWR) && (hdr.flags & ADV_FLAG_TXPWR)) {
+            held->hdr.txPower = hdr.txPower;
+            held->hdr.flags |= ADV_FLAG_TXPWR;
+        }
+        held->used = false;
+        bump(_merged);
+        emit(held->hdr, held->ad);
+        return;
+    }
+
+    if (!(hdr.flags & ADV_FLAG_SCANNABLE)) {
+        // nothing to wait for; a held advert from this device goes first
+        if (held) {
+            held->used = false;
+            bump(_unmatched);
+            emit(held->hdr, held->ad);
+        }
+        emit(hdr, ad);
+        return;
+    }
+
+    // a new scannable advert: the previous one from this device got no
+    // response
+    if (held) {
+        held->used = false;
+        bump(_unmatched);
+        emit(held->hdr, held->ad);
+    } else {
+        held = oldest();
+        if (held->used) {
+            held->used = false;
+            bump(_unmatched);
+            emit(held->hdr, held->ad);
+        }
+    }
+    held->used = true;
+    held->hdr = hdr;
+    memcpy(held->ad, ad, hdr.adLen);
+}
+
+void ScanMerge::expire(uint64_t nowUs, Emit emit) {
+    for (size_t i = 0; i < _count; i++) {
+        Slot &s = _slots[i];
+        if (s.used && nowUs - s.hdr.timeUs >= _timeoutUs) {
+            s.used = false;
+            bump(_unmatched);
+            emit(s.hdr, s.ad);
+        }
+    }
+}
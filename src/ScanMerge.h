@@ -0,0 +1,73 @@
+/// @file ScanMerge.h
+/// @brief Per-MAC buffer joining an advert with its active-scan response.
+///
+/// With active scanning the stack reports the advert (ADV_IND / ADV_SCAN_IND)
+/// and the SCAN_RSP as two separate results, told apart by the GAP event
+/// type the scan callback keeps in AdvRecord::flags. A scannable advert
+/// (ADV_FLAG_SCANNABLE) is held here for up to timeoutMs; when a scan
+/// response (ADV_FLAG_SCAN_RSP) arrives for the same MAC, the two AD payloads
+/// are concatenated into one record and emitted together. Held adverts that
+/// see no response are emitted alone by expire(), and any other advert from
+/// the same device flushes the held one first. Other results pass straight
+/// through.
+///
+/// Only legacy-sized payloads (<= 31 bytes each) are held. Not thread safe;
+/// the caller serializes offer() and expire().
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "advrecord.hpp"
+#include "counters.hpp"
+
+class ScanMerge {
+public:
+    /// Receives every record leaving the buffer.
+    using Emit = void (*)(const AdvRecord &hdr, const uint8_t *ad);
+
+    /// Largest advert or scan response payload that is held for merging.
+    static constexpr size_t MAX_PART = 31;
+
+    ScanMerge() = default;
+    ~ScanMerge();
+    ScanMerge(const ScanMerge &) = delete;
+    ScanMerge &operator=(const ScanMerge &) = delete;
+
+    bool create(size_t slots, uint32_t timeoutMs);
+
+    /// Hand over one scan result; emits zero, one or two records.
+    void offer(const AdvRecord &hdr, const uint8_t *ad, Emit emit);
+
+    /// Emit held adverts older than the timeout.
+    void expire(uint64_t nowUs, Emit emit);
+
+    bool enabled() const {
+        return _slots != nullptr;
+    }
+    /// Counters may be read from any task while offer() and expire() run;
+    /// the caller's CounterWrite makes them part of its snapshot.
+    uint32_t merged() const {
+        return peek(_merged);
+    }
+    /// Adverts emitted without a scan response (timed out or superseded).
+    uint32_t unmatched() const {
+        return peek(_unmatched);
+    }
+
+private:
+    struct Slot {
+        bool used;
+        AdvRecord hdr;
+        uint8_t ad[2 * MAX_PART];
+    };
+
+    Slot *_slots = nullptr;
+    size_t _count = 0;
+    uint64_t _timeoutUs = 0;
+    Counter _merged{0};
+    Counter _unmatched{0};
+
+    Slot *find(const uint8_t mac[6]);
+    Slot *oldest();
+};
@@ -0,0 +1,261 @@
+/// @file adparser.hpp
+/// @brief Zero-copy parser for raw BLE AD structures.
+///
+/// An advertising or scan response payload is a sequence of
+/// [len][type][data...] elements where len counts type + data. AdParser
+/// iterates the elements in place and AdFields collects the ones the scanner
+/// uses in a single pass; every result is a ByteView into the caller's
+/// buffer, so nothing is copied and nothing is allocated.
+///
+/// Malformed input is expected (the payload comes off the air): a zero length
+/// byte ends the walk as padding, and an element running past the end of the
+/// buffer ends it and marks the payload truncated. No read ever goes past
+/// ptr + len.
+///
+/// Pure C++ with no platform dependencies, so it builds on the host for
+/// benchmarking and fuzzing.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/// AD types referenced by the scanner (Core Specification Supplement, Part A).
+enum : uint8_t {
+    AD_TYPE_FLAGS            = 0x01,
+    AD_TYPE_UUID16_PARTIAL   = 0x02,
+    AD_TYPE_UUID16_COMPLETE  = 0x03,
+    AD_TYPE_UUID32_PARTIAL   = 0x04,
+    AD_TYPE_UUID32_COMPLETE  = 0x05,
+    AD_TYPE_UUID128_PARTIAL  = 0x06,
+    AD_TYPE_UUID128_COMPLETE = 0x07,
+    AD_TYPE_NAME_SHORT       = 0x08,
+    AD_TYPE_NAME_COMPLETE    = 0x09,
+    AD_TYPE_TX_POWER         = 0x0A,
+    AD_TYPE_SERVICE_DATA16   = 0x16,
+    AD_TYPE_SERVICE_DATA32   = 0x20,
+    AD_TYPE_SERVICE_DATA128  = 0x21,
+    AD_TYPE_MANUFACTURER     = 0xFF,
+};
+
+/// Non-owning view of a byte range inside a payload.
+struct ByteView {
+    const uint8_t *ptr = nullptr;
+    size_t len = 0;
+
+    const uint8_t *data() const {
+        return ptr;
+    }
+    size_t size() const {
+        return len;
+    }
+    bool empty() const {
+        return len == 0;
+    }
+    uint8_t operator[](size_t i) const {
+        return ptr[i];
+    }
+};
+
+/// One AD element: its type and the data following the type byte.
+struct AdElement {
+    uint8_t type = 0;
+    ByteView data;
+};
+
+/// Range over the AD elements of a payload:
+/// @code
+///   AdParser p(ad, len);
+///   for (AdElement e : p) { ... }
+///   if (p.truncated()) { ... }
+/// @endcode
+class AdParser {
+public:
+    AdParser(const uint8_t *ad, size_t len) : _ad(ad), _len(len) {}
+
+    class iterator {
+    public:
+        iterator(const AdParser *p, size_t pos) : _p(p), _pos(pos) {
+            settle();
+        }
+        AdElement operator*() const {
+            uint8_t l = _p->_ad[_pos];
+            return {_p->_ad[_pos + 1], {_p->_ad + _pos + 2, (size_t)(l - 1)}};
+        }
+        iterator &operator++() {
+            _pos += 1 + _p->_ad[_pos];
+            settle();
+            return *this;
+        }
+        bool operator!=(const iterator &o) const {
+            return _pos != o._pos;
+        }
+
+    private:
+        const AdParser *_p;
+        size_t _pos;
+
+        // jump to end() unless a complete element starts at _pos
+        void settle() {
+            if (_pos >= _p->_len)
+                _pos = _p->_len;
+            else if (_p->_ad[_pos] == 0 || _pos + 1 + _p->_ad[_pos] > _p->_len)
+                _pos = _p->_len;
+        }
+    };
+
+    iterator begin() const {
+        return iterator(this, 0);
+    }
+    iterator end() const {
+        return iterator(this, _len);
+    }
+
+    /// True if an element claims more bytes than the payload holds.
+    bool truncated() const {
+        size_t i = 0;
+        while (i < _len) {
+            uint8_t l = _ad[i];
+            if (l == 0)
+                return false;
+            if (i + 1 + l > _len)
+                return true;
+            i += 1 + l;
+        }
+        return false;
+    }
+
+private:
+    const uint8_t *_ad;
+    size_t _len;
+};
+
+/// Walk the AD structures of a payload, calling fn(type, data, len) for each
+/// element. A zero length byte (padding) or a truncated element ends the walk.
+template <typename F>
+inline void forEachAD(const uint8_t *ad, size_t len, F &&fn) {
+    for (AdElement e : AdParser(ad, len))
+        fn(e.type, e.data.data(), e.data.size());
+}
+
+/// Service data elements kept per payload; further entries are counted in
+/// AdFields::serviceDataDropped.
+static constexpr size_t AD_MAX_SERVICE_DATA = 8;
+
+/// One service data element, split into its UUID and payload.
+struct AdServiceData {
+    ByteView uuid; ///< 2, 4 or 16 bytes, little endian
+    ByteView data;
+
+    /// 16-bit UUID, or 0 if this entry uses a wider one.
+    uint16_t uuid16() const {
+        return uuid.size() == 2 ? (uint16_t)(uuid[0] | (uuid[1] << 8)) : 0;
+    }
+};
+
+/// The AD elements the scanner uses, gathered in one pass by parseAd().
+struct AdFields {
+    uint8_t flags = 0;
+    bool hasFlags = false;
+    int8_t txPower = 0;
+    bool hasTxPower = false;
+    ByteView name;       ///< complete local name, else the shortened one
+    ByteView mfd;        ///< manufacturer data including the company ID
+    ByteView uuids16;    ///< 16-bit service UUID list (partial or complete)
+    ByteView uuids32;    ///< 32-bit service UUID list
+    ByteView uuids128;   ///< 128-bit service UUID list
+    AdServiceData serviceData[AD_MAX_SERVICE_DATA];
+    uint8_t serviceDataCount = 0;
+    uint16_t serviceDataDropped = 0;
+    bool truncated = false;
+
+    /// First advertised service UUID (narrowest list first), or empty.
+    ByteView firstServiceUuid() const {
+        if (uuids16.size() >= 2)
+            return {uuids16.data(), 2};
+        if (uuids32.size() >= 4)
+            return {uuids32.data(), 4};
+        if (uuids128.size() >= 16)
+            return {uuids128.data(), 16};
+        return {};
+    }
+
+    /// Service data entry with the given 16-bit UUID, or nullptr.
+    const AdServiceData *findServiceData16(uint16_t uuid) const {
+        for (size_t i = 0; i < serviceDataCount; i++)
+            if (serviceData[i].uuid16() == uuid)
+                return &serviceData[i];
+        return nullptr;
+    }
+};
+
+/// Parse a payload into f in a single pass. Returns false if the payload
+/// was truncated; the elements before the damage are still filled in.
+inline bool parseAd(const uint8_t *ad, size_t len, AdFields &f) {
+    f = AdFields();
+    size_t i = 0;
+    while (i < len) {
+        uint8_t l = ad[i];
+        if (l == 0)
+            break;
+        if (i + 1 + l > len) {
+            f.truncated = true;
+            break;
+        }
+        uint8_t type = ad[i + 1];
+        const uint8_t *data = ad + i + 2;
+        size_t n = l - 1;
+        i += 1 + l;
+
+        switch (type) {
+            case AD_TYPE_FLAGS:
+                if (n >= 1) {
+                    f.flags = data[0];
+                    f.hasFlags = true;
+                }
+                break;
+            case AD_TYPE_TX_POWER:
+                if (n >= 1) {
+                    f.txPower = (int8_t)data[0];
+                    f.hasTxPower = true;
+                }
+                break;
+            case AD_TYPE_NAME_COMPLETE:
+                f.name = {data, n};
+                break;
+            case AD_TYPE_NAME_SHORT:
+                if (f.name.empty())
+                    f.name = {data, n};
+                break;
+            case AD_TYPE_MANUFACTURER:
+                f.mfd = {data, n};
+                break;
+            case AD_TYPE_UUID16_PARTIAL:
+            case AD_TYPE_UUID16_COMPLETE:
+                f.uuids16 = {data, n & ~(size_t)1};
+                break;
+            case AD_TYPE_UUID32_PARTIAL:
+            case AD_TYPE_UUID32_COMPLETE:
+                f.uuids32 = {data, n & ~(size_t)3};
+                break;
+            case AD_TYPE_UUID128_PARTIAL:
+            case AD_TYPE_UUID128_COMPLETE:
+                f.uuids128 = {data, n & ~(size_t)15};
+                break;
+            case AD_TYPE_SERVICE_DATA16:
+            case AD_TYPE_SERVICE_DATA32:
+            case AD_TYPE_SERVICE_DATA128: {
+                    size_t w = type == AD_TYPE_SERVICE_DATA16 ? 2 :
+                               type == AD_TYPE_SERVICE_DATA32 ? 4 : 16;
+                    if (n < w)
+                        break;
+                    if (f.serviceDataCount == AD_MAX_SERVICE_DATA) {
+                        f.serviceDataDropped++;
+                        break;
+                    }
+                    f.serviceData[f.serviceDataCount++] = {{data, w}, {data + w, n - w}};
+                    break;
+                }
+        }
+    }
+    return !f.truncated;
+}
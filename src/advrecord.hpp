@@ -0,0 +1,63 @@
+/// @file advrecord.hpp
+/// @brief Fixed-layout binary advertisement record carried in the BLE queue.
+///
+/// A record is a packed AdvRecord header followed by adLen bytes of raw AD
+/// structures exactly as received over the air: a sequence of
+/// [len][type][data...] elements where len counts type + data. The scan
+/// callback writes records straight into the slot returned by send_acquire(),
+/// and the consumer walks them in place - no serialization in either direction.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "adparser.hpp"
+#include "hexcodec.hpp"
+
+/// AdvRecord::flags bits
+enum : uint8_t {
+    ADV_FLAG_TXPWR     = 0x01, ///< txPower holds a valid value
+    ADV_FLAG_SCANNABLE = 0x02, ///< ADV_IND / ADV_SCAN_IND: a scan response may follow
+    ADV_FLAG_SCAN_RSP  = 0x04, ///< the AD structures are a scan response
+};
+
+struct __attribute__((packed)) AdvRecord {
+    uint8_t  mac[6];  ///< device address, most significant byte first
+    int8_t   rssi;    ///< dBm
+    int8_t   txPower; ///< dBm, valid if ADV_FLAG_TXPWR is set
+    uint64_t timeUs;  ///< esp_timer_get_time() when the advert was reported
+    uint8_t  flags;   ///< ADV_FLAG_*
+    uint16_t adLen;   ///< bytes of AD structures following the header
+    uint32_t queuedUs; ///< time from timeUs until the record was queued
+    uint32_t traceId; ///< sampled trace ID, 0 if not traced
+
+    const uint8_t *ad() const {
+        return reinterpret_cast<const uint8_t *>(this + 1);
+    }
+    uint8_t *ad() {
+        return reinterpret_cast<uint8_t *>(this + 1);
+    }
+    /// Total record size including the AD structures.
+    size_t size() const {
+        return sizeof(AdvRecord) + adLen;
+    }
+};
+
+static_assert(sizeof(AdvRecord) == 27, "AdvRecord must stay packed");
+
+/// Upper bound for the AD part of a record (extended advertising maximum).
+static constexpr size_t ADV_MAX_AD_LEN = 1650;
+
+/// Longest device name an AD element can carry.
+static constexpr size_t ADV_MAX_NAME_LEN = 248;
+
+/// The parsed AD elements of a queued record, as views into it.
+/// Only valid while the record is held (between receive and return_item).
+struct AdvView : AdFields {
+    const AdvRecord *rec = nullptr;
+};
+
+inline void viewRecord(const AdvRecord *rec, AdvView &v) {
+    parseAd(rec->ad(), rec->adLen, v);
+    v.rec = rec;
+}
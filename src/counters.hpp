@@ -0,0 +1,79 @@
+/// @file counters.hpp
+/// @brief Single-writer statistics counters with consistent snapshots.
+///
+/// Each group of counters belongs to exactly one writer (the scan callback,
+/// the loop task, one decode worker). The writer brackets every batch of
+/// updates with a CounterWrite, which bumps a sequence number around it; a
+/// reader copies the group inside CounterSeq::read() and retries if the
+/// sequence moved, so it never sees half of an update. Readers never block
+/// the writer. Counters are relaxed atomics, so a torn or stale read is
+/// impossible even on the retry path, and a single writer can increment
+/// with a plain load/store instead of an atomic read-modify-write.
+///
+/// Pure C++, builds on the host.
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+using Counter = std::atomic<uint32_t>;
+
+/// Writer side: add n to a counter of a group this task owns.
+inline void bump(Counter &c, uint32_t n = 1) {
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/// Writer side: raise a counter to v if it is lower.
+inline void bumpMax(Counter &c, uint32_t v) {
+    if (v > c.load(std::memory_order_relaxed))
+        c.store(v, std::memory_order_relaxed);
+}
+
+/// Read a counter without snapshot guarantees.
+inline uint32_t peek(const Counter &c) {
+    return c.load(std::memory_order_relaxed);
+}
+
+/// Sequence number guarding one counter group.
+class CounterSeq {
+public:
+    /// Call copy() until it ran without a concurrent write, at most
+    /// `tries` times. Returns false if the last copy may be inconsistent.
+    template <typename F>
+    bool read(F &&copy, int tries = 8) const {
+        for (int i = 0; i < tries; i++) {
+            uint32_t before = _seq.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+            copy();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_seq.load(std::memory_order_relaxed) == before)
+                return true;
+        }
+        copy();
+        return false;
+    }
+
+private:
+    friend class CounterWrite;
+    std::atomic<uint32_t> _seq{0};
+};
+
+/// Writer side: marks the group as being updated for the object's lifetime.
+class CounterWrite {
+public:
+    explicit CounterWrite(CounterSeq &seq) : _seq(seq) {
+        _seq._seq.store(_seq._seq.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    ~CounterWrite() {
+        _seq._seq.store(_seq._seq.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_release);
+    }
+    CounterWrite(const CounterWrite &) = delete;
+    CounterWrite &operator=(const CounterWrite &) = delete;
+
+private:
+    CounterSeq &_seq;
+};
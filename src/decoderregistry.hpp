@@ -0,0 +1,43 @@
+/// @file decoderregistry.hpp
+/// @brief Lookup of decoders by 16-bit ID in sorted constexpr tables.
+///
+/// BLEScanner keeps one table per kind of key (company ID, service data
+/// UUID). sortedById() lets a table be checked with static_assert, and
+/// findDecoder() binary searches it; the tables are short, so a lookup is
+/// a few compares with no hashing and no allocation.
+///
+/// Pure C++, builds on the host.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+template <typename Fn>
+struct DecoderEntry {
+    uint16_t id;
+    Fn decode;
+};
+
+/// True if the IDs of table are strictly ascending.
+template <typename Fn, size_t N>
+constexpr bool sortedById(const DecoderEntry<Fn> (&table)[N]) {
+    for (size_t i = 1; i < N; i++)
+        if (table[i - 1].id >= table[i].id)
+            return false;
+    return true;
+}
+
+/// Decoder registered for id, or nullptr. The search narrows to the last
+/// entry not above id with conditional moves rather than branches, since
+/// the IDs of a scan's adverts are too mixed to predict; with N a constant
+/// the loop unrolls into log2(N) steps.
+template <typename Fn, size_t N>
+inline Fn findDecoder(const DecoderEntry<Fn> (&table)[N], uint16_t id) {
+    const DecoderEntry<Fn> *first = table;
+    for (size_t len = N; len > 1; ) {
+        size_t half = len / 2;
+        first = first[half].id <= id ? first + half : first;
+        len -= half;
+    }
+    return first->id == id ? first->decode : nullptr;
+}
@@ -0,0 +1,216 @@
+/// @file hostqueue.hpp
+/// @brief POSIX stand-in for the ESP-IDF NOSPLIT ring buffer.
+///
+/// HostRingBuffer implements ItemQueue with the semantics the pipeline
+/// relies on from espidf::RingBuffer (RINGBUF_TYPE_NOSPLIT):
+///   - items are contiguous; one that does not fit before the end of the
+///     buffer is placed at the start and the tail bytes are skipped
+///   - items are received in send_acquire() order, and an acquired item
+///     that has not been completed yet holds back the ones behind it
+///   - received items may be returned in any order; space is reclaimed
+///     once every older item has been returned
+///   - any thread may send or receive (a mutex serializes them), and the
+///     producer may discard_oldest() while the consumer holds an item
+///
+/// Blocking waits use a condition variable; usage and the high water mark
+/// are atomics so statistics can be read without the lock. Used in place
+/// of espidf::RingBuffer when building without ESP_PLATFORM.
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+
+#include "itemqueue.hpp"
+
+class HostRingBuffer : public ItemQueue {
+public:
+    HostRingBuffer() = default;
+    ~HostRingBuffer() override {
+        free();
+    }
+    HostRingBuffer(const HostRingBuffer &) = delete;
+    HostRingBuffer &operator=(const HostRingBuffer &) = delete;
+
+    /// Allocate sz bytes of storage (rounded down to a multiple of 8).
+    bool create(size_t sz) {
+        free();
+        _size = sz & ~(size_t)7;
+        _buf = static_cast<uint8_t *>(std::malloc(_size));
+        _head = _read = _tail = 0;
+        _unread = 0;
+        _used.store(0, std::memory_order_relaxed);
+        _hwm.store(0, std::memory_order_relaxed);
+        return _buf != nullptr;
+    }
+
+    void free() {
+        std::free(_buf);
+        _buf = nullptr;
+        _size = 0;
+    }
+
+    /// Largest payload a single item can carry. Half the buffer, as with
+    /// SpscQueue, so an item plus the skipped tail always fits once drained.
+    size_t max_item_size() const {
+        return _size / 2 - sizeof(Header);
+    }
+
+    bool send_acquire(void **item, size_t size, uint32_t waitMs) override {
+        if (!_buf || size > max_item_size())
+            return false;
+        size_t need = span(size);
+        std::unique_lock<std::mutex> lock(_lock);
+        size_t skip = 0;
+        auto fits = [&] {
+            size_t contig = _size - _head;
+            skip = need > contig ? contig : 0;
+            return _size - used() >= skip + need;
+        };
+        if (!fits() && (!waitMs ||
+                        !_space.wait_for(lock, std::chrono::milliseconds(waitMs), fits)))
+            return false;
+
+        if (skip) {
+            *at(_head) = {(uint32_t)(skip - sizeof(Header)), PAD};
+            advance(_head, skip);
+        }
+        Header *h = at(_head);
+        *h = {(uint32_t)size, ACQUIRED};
+        advance(_head, need);
+        _unread += skip + need;
+        size_t now = used() + skip + need;
+        _used.store(now, std::memory_order_relaxed);
+        size_t hwm = _hwm.load(std::memory_order_relaxed);
+        if (now > hwm)
+            _hwm.store(now, std::memory_order_relaxed);
+        *item = h + 1;
+        return true;
+    }
+
+    bool send_complete(void *item) override {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            header(item)->state = READY;
+        }
+        _data.notify_one();
+        return true;
+    }
+
+    void *receive(size_t *size, uint32_t waitMs) override {
+        std::unique_lock<std::mutex> lock(_lock);
+        auto ready = [this] {
+            skip_pads();
+            return _unread && at(_read)->state == READY;
+        };
+        if (!ready() && (!waitMs ||
+                         !_data.wait_for(lock, std::chrono::milliseconds(waitMs), ready)))
+            return nullptr;
+        Header *h = at(_read);
+        h->state = RECEIVED;
+        take(h);
+        *size = h->len;
+        return h + 1;
+    }
+
+    void return_item(void *item) override {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            header(item)->state = RETURNED;
+            reclaim();
+        }
+        _space.notify_all();
+    }
+
+    bool discard_oldest() override {
+        std::lock_guard<std::mutex> lock(_lock);
+        skip_pads();
+        if (!_unread || at(_read)->state != READY)
+            return false;
+        Header *h = at(_read);
+        h->state = RETURNED;
+        take(h);
+        reclaim();
+        return true;
+    }
+
+    size_t get_current_usage() const override {
+        return _used.load(std::memory_order_relaxed);
+    }
+
+    size_t get_high_watermark() const override {
+        return _hwm.load(std::memory_order_relaxed);
+    }
+
+    size_t get_total_size() const override {
+        return _size;
+    }
+
+    void reset_high_watermark() override {
+        _hwm.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    enum : uint32_t { PAD, ACQUIRED, READY, RECEIVED, RETURNED };
+
+    struct Header {
+        uint32_t len;   ///< payload bytes
+        uint32_t state;
+    };
+
+    static size_t span(size_t size) {
+        return (sizeof(Header) + size + 7) & ~(size_t)7;
+    }
+    static Header *header(void *item) {
+        return static_cast<Header *>(item) - 1;
+    }
+    Header *at(size_t offset) const {
+        return reinterpret_cast<Header *>(_buf + offset);
+    }
+    void advance(size_t &offset, size_t n) const {
+        offset += n;
+        if (offset == _size)
+            offset = 0;
+    }
+    size_t used() const {
+        return _used.load(std::memory_order_relaxed);
+    }
+
+    // consumer position moves past h
+    void take(Header *h) {
+        _unread -= span(h->len);
+        advance(_read, span(h->len));
+    }
+
+    void skip_pads() {
+        while (_unread && at(_read)->state == PAD)
+            take(at(_read));
+    }
+
+    // free everything before the read position that has been handed back
+    void reclaim() {
+        size_t now = used();
+        while (now > _unread) {
+            Header *h = at(_tail);
+            if (h->state != PAD && h->state != RETURNED)
+                break;
+            now -= span(h->len);
+            advance(_tail, span(h->len));
+        }
+        _used.store(now, std::memory_order_relaxed);
+    }
+
+    uint8_t *_buf = nullptr;
+    size_t _size = 0;
+    size_t _head = 0;   ///< next write offset
+    size_t _read = 0;   ///< next item to receive
+    size_t _tail = 0;   ///< oldest byte not yet reclaimed
+    size_t _unread = 0; ///< bytes from _read to _head
+    std::atomic<size_t> _used{0}; ///< bytes from _tail to _head
+    std::atomic<size_t> _hwm{0};
+    std::mutex _lock;
+    std::condition_variable _space;
+    std::condition_variable _data;
+};
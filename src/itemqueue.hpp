@@ -0,0 +1,49 @@
+/// @file itemqueue.hpp
+/// @brief Zero-copy variable-length item queue interface.
+///
+/// Mirrors the RINGBUF_TYPE_NOSPLIT subset of the ESP-IDF ring buffer API the
+/// BLE pipeline uses: the producer reserves a contiguous slot with
+/// send_acquire(), fills it in place and publishes it with send_complete();
+/// the consumer borrows the oldest item with receive() and hands the space
+/// back with return_item(). Implemented by espidf::RingBuffer, SpscQueue and
+/// HostRingBuffer.
+/// Kept free of FreeRTOS types so queue implementations build on the host.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+class ItemQueue {
+public:
+    virtual ~ItemQueue() = default;
+
+    /// Reserve `size` contiguous bytes, waiting up to waitMs for space.
+    virtual bool send_acquire(void **item, size_t size, uint32_t waitMs) = 0;
+
+    /// Publish a slot obtained from send_acquire().
+    virtual bool send_complete(void *item) = 0;
+
+    /// Borrow the oldest item, waiting up to waitMs. Returns nullptr if empty.
+    virtual void *receive(size_t *size, uint32_t waitMs) = 0;
+
+    /// Release an item obtained from receive().
+    virtual void return_item(void *item) = 0;
+
+    /// Producer side: drop the oldest unread item to make room. Returns false
+    /// if the queue is empty or the implementation cannot evict from the
+    /// producer (e.g. SpscQueue, whose tail belongs to the consumer).
+    virtual bool discard_oldest() {
+        return false;
+    }
+
+    virtual size_t get_current_usage() const = 0;
+    virtual size_t get_high_watermark() const = 0;
+    virtual size_t get_total_size() const = 0;
+
+    /// Sample current usage into the high water mark and return the usage.
+    /// Queues that track the mark on every send only report the usage.
+    virtual size_t update_high_watermark() {
+        return get_current_usage();
+    }
+    virtual void reset_high_watermark() = 0;
+};
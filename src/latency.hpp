@@ -0,0 +1,92 @@
+/// @file latency.hpp
+/// @brief Lock-free log-linear latency histogram with percentile summaries.
+///
+/// Microsecond samples are counted in buckets of four per power of two, so
+/// a percentile read back is within 25% of the true value (reported as the
+/// bucket's upper bound, capped at the observed maximum) over the whole
+/// 1 us .. 71 min range in about 500 bytes. Any number of tasks may call
+/// record(); take() reads and optionally clears the window without a lock,
+/// and a sample racing with the clear lands in either window, never none.
+///
+/// Pure C++, builds on the host.
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class LatencyHistogram {
+public:
+    static constexpr size_t SUB_BUCKETS = 4;
+    static constexpr size_t BUCKETS = SUB_BUCKETS + 30 * SUB_BUCKETS;
+
+    struct Summary {
+        uint32_t count;
+        uint32_t p50Us;
+        uint32_t p99Us;
+        uint32_t maxUs;
+    };
+
+    void record(uint32_t us) {
+        _buckets[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+        uint32_t max = _max.load(std::memory_order_relaxed);
+        while (us > max &&
+                !_max.compare_exchange_weak(max, us, std::memory_order_relaxed))
+            ;
+    }
+
+    /// Summarize the samples since the last take(reset = true).
+    Summary take(bool reset) {
+        uint32_t counts[BUCKETS];
+        Summary s = {};
+        for (size_t i = 0; i < BUCKETS; i++) {
+            counts[i] = reset ? _buckets[i].exchange(0, std::memory_order_relaxed)
+                        : _buckets[i].load(std::memory_order_relaxed);
+            s.count += counts[i];
+        }
+        s.maxUs = reset ? _max.exchange(0, std::memory_order_relaxed)
+                  : _max.load(std::memory_order_relaxed);
+        s.p50Us = percentile(counts, s.count, 50, s.maxUs);
+        s.p99Us = percentile(counts, s.count, 99, s.maxUs);
+        return s;
+    }
+
+private:
+    // values below SUB_BUCKETS are exact; above, the top three bits pick
+    // the bucket within the power of two
+    static size_t bucketOf(uint32_t v) {
+        if (v < SUB_BUCKETS)
+            return v;
+        int octave = 31 - __builtin_clz(v);
+        size_t sub = (v >> (octave - 2)) & (SUB_BUCKETS - 1);
+        return SUB_BUCKETS + (octave - 2) * SUB_BUCKETS + sub;
+    }
+
+    static uint32_t upperBound(size_t b) {
+        if (b < SUB_BUCKETS)
+            return (uint32_t)b;
+        size_t octave = (b - SUB_BUCKETS) / SUB_BUCKETS + 2;
+        uint64_t base = (uint64_t)(SUB_BUCKETS + (b & (SUB_BUCKETS - 1))) << (octave - 2);
+        uint64_t top = base + ((uint64_t)1 << (octave - 2)) - 1;
+        return top > UINT32_MAX ? UINT32_MAX : (uint32_t)top;
+    }
+
+    static uint32_t percentile(const uint32_t *counts, uint32_t total,
+                               uint32_t pct, uint32_t max) {
+        if (!total)
+            return 0;
+        uint64_t rank = ((uint64_t)total * pct + 99) / 100; // 1-based, rounded up
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                uint32_t v = upperBound(i);
+                return v < max ? v : max;
+            }
+        }
+        return max;
+    }
+
+    std::atomic<uint32_t> _buckets[BUCKETS] = {};
+    std::atomic<uint32_t> _max{0};
+};
@@ -7,6 +7,10 @@
 #include "ESP_HostedOTA.h"
 #include <SD_MMC.h>
 #include "BLEScanner.h"
+#include "DeviceTable.h"
+#include "BTHomeKeyStore.h"
+#include "hexcodec.hpp"
+#include "esp_timer.h"
 
 #ifdef LVGL_UI
     #include "display_driver.h"
@@ -41,7 +45,21 @@ void setup() {
     WiFi.STA.begin();
     log_w("connecting to SSID %s", WIFI_SSID);
     WiFi.STA.connect(WIFI_SSID, WIFI_PASS);
-    bleScanner.begin(4096, 15000, 100, 99, 4096, 1, MALLOC_CAP_SPIRAM);
+    bleScanner.setDedup(5000, 30000);
+    bleScanner.setWorkers(1, 0);   // decode on core 0, loop() only publishes
+    bleScanner.setOverloadPolicy(BLEScanner::OverloadPolicy::CoalesceByMac);
+    bleScanner.setDeviceTable(256);
+    bleScanner.setTraceSampling(1000);   // "trace" on every 1000th advert
+    bleScanner.setLowPriorityLane(1024);  // unknown devices can't crowd out sensors
+#ifndef BLE_RAW_UNKNOWN
+    bleScanner.setRawUnknown(false);     // unknown devices go to ble/$unknown
+#endif
+    bleScanner.setContinuousScan(true);
+    if (BTHomeKeyStore *keys = bleScanner.bthomeKeys())
+        keys->loadNvs();                 // per-device keys, count in ble/$stats
+    // 2 KB internal SRAM front per queue, bursts spill into 16 KB of PSRAM
+    bleScanner.begin(16384, 15000, 100, 99, 4096, 1, MALLOC_CAP_SPIRAM,
+                     BLEScanner::QueueType::Tiered);
 }
 
 void loop() {
@@ -84,36 +102,164 @@ void loop() {
 #ifdef LVGL_UI
     display_update();
 #endif
-    {
-        JsonDocument doc;
-        char mac[16];
-        if (bleScanner.process(doc, mac, sizeof(mac))) {
-            String topic = String("ble/") + mac;
-            auto publish = mqtt.begin_publish(topic.c_str(), measureJson(doc));
-            serializeJson(doc, publish);
-            publish.send();
+    bleScanner.drainOutput(16, 2000, [](const char *mac, const char *json, size_t len) {
+        char topic[20];
+        snprintf(topic, sizeof(topic), "ble/%s", mac);
+        auto publish = mqtt.begin_publish(topic, len);
+        publish.write((const uint8_t *)json, len);
+        publish.send();
+    });
+    // ble/$stats goes out once per 5 s rate window, however busy the scanner
+    static uint32_t lastStats = 0;
+    if (millis() - lastStats >= 5000) {
+        lastStats = millis();
+        static BLEScanner::Stats rateBase = {};
+        BLEScanner::Rates rates = {};
+        auto st = bleScanner.stats();
+        if (rateBase.timeUs)
+            rates = BLEScanner::rates(rateBase, st);
+        rateBase = st;
+        JsonDocument sdoc;
+        sdoc["hwm"] = st.hwmPercent;
+        sdoc["qfull"] = st.queueFull;
+        sdoc["afail"] = st.acquireFail;
+        sdoc["rx"] = st.received;
+        sdoc["dec"] = st.decoded;
+        sdoc["fmac"] = st.filterMac;
+        sdoc["fcid"] = st.filterCompany;
+        sdoc["fuuid"] = st.filterUuid;
+        sdoc["fna"] = st.filterNotAllowed;
+        AdvFilter::RuleHits rules[16];
+        if (size_t n = bleScanner.filterHits(rules, 16)) {
+            static const char *const KINDS[] = {"mac", "cid", "uuid"};
+            JsonArray fr = sdoc["frules"].to<JsonArray>();
+            for (size_t i = 0; i < n; i++) {
+                JsonObject r = fr.add<JsonObject>();
+                r["rule"] = rules[i].allow ? "allow" : "deny";
+                if (rules[i].kind == AdvFilter::RuleHits::MAC) {
+                    char mac[13];
+                    snprintf(mac, sizeof(mac), "%012llX", (unsigned long long)rules[i].key);
+                    r["mac"] = mac;
+                } else {
+                    r[KINDS[rules[i].kind]] = rules[i].key;
+                }
+                r["n"] = rules[i].hits;
+            }
+        }
+        sdoc["dup"] = st.suppressed;
+        sdoc["reemit"] = st.reemitted;
+        sdoc["evict"] = st.evicted;
+        sdoc["coal"] = st.coalesced;
+        sdoc["coalfull"] = st.coalesceFull;
+        sdoc["merged"] = st.scanMerged;
+        sdoc["unmatched"] = st.scanUnmatched;
+        sdoc["spill"] = st.spilledItems;
+        sdoc["spillb"] = st.spilledBytes;
+        sdoc["spillhwm"] = st.spillHwmBytes;
+        sdoc["restarts"] = st.scanRestarts;
+        sdoc["maxgap"] = st.maxGapMs;
+        sdoc["heap"] = st.heapFree;
+        sdoc["heapmin"] = st.heapMinFree;
+        sdoc["qps"] = rates.queued;
+        sdoc["rxps"] = rates.received;
+        sdoc["decps"] = rates.decoded;
+        sdoc["dropps"] = rates.dropped;
+        JsonArray occ = sdoc["occ"].to<JsonArray>();
+        for (uint32_t n : st.occupancy)
+            occ.add(n);
+        if (DeviceTable *devices = bleScanner.devices()) {
+            sdoc["devs"] = devices->size();
+            sdoc["devevict"] = devices->evictions();
+            sdoc["devskip"] = devices->skipped();
+        }
+        if (BTHomeKeyStore *keys = bleScanner.bthomeKeys()) {
+            auto ks = keys->stats();
+            sdoc["bthkeys"] = ks.keys;
+            sdoc["bthhit"] = ks.hits;
+            sdoc["bthdef"] = ks.defaults;
+            sdoc["bthmiss"] = ks.misses;
+            sdoc["bthfail"] = ks.failures;
+        }
+        JsonArray lanes = sdoc["lanes"].to<JsonArray>();
+        for (size_t i = 0; i < BLEScanner::LANE_COUNT; i++) {
+            auto ls = bleScanner.laneStats((BLEScanner::Lane)i);
+            JsonObject l = lanes.add<JsonObject>();
+            l["q"] = ls.queued;
+            l["drop"] = ls.dropped;
+            l["hwm"] = ls.hwmBytes;
         }
+        JsonArray workers = sdoc["workers"].to<JsonArray>();
+        for (size_t i = 0; i < bleScanner.workerCount(); i++) {
+            auto ws = bleScanner.workerStats(i);
+            JsonObject w = workers.add<JsonObject>();
+            w["util"] = ws.utilization;
+            w["qlen"] = ws.queueBytes;
+            w["hwm"] = ws.hwmBytes;
+            w["odrop"] = ws.outputDrops;
+        }
+        auto publish = mqtt.begin_publish("ble/$stats", measureJson(sdoc));
+        serializeJson(sdoc, publish);
+        publish.send();
     }
-    {
-        static BLEScanner::Stats lastStats = {};
-        auto st = bleScanner.stats();
-        if (st.hwmBytes > lastStats.hwmBytes ||
-                st.queueFull > lastStats.queueFull ||
-                st.acquireFail > lastStats.acquireFail ||
-                st.received > lastStats.received ||
-                st.decoded > lastStats.decoded) {
-            lastStats = st;
-            JsonDocument sdoc;
-            sdoc["hwm"] = st.hwmPercent;
-            sdoc["qfull"] = st.queueFull;
-            sdoc["afail"] = st.acquireFail;
-            sdoc["rx"] = st.received;
-            sdoc["dec"] = st.decoded;
-            auto publish = mqtt.begin_publish("ble/$stats", measureJson(sdoc));
-            serializeJson(sdoc, publish);
+    static uint32_t lastUnknown = 0;
+    if (millis() - lastUnknown > 30000) {
+        lastUnknown = millis();
+        JsonDocument udoc;
+        if (bleScanner.unknownSummary(udoc)) {
+            auto publish = mqtt.begin_publish("ble/$unknown", measureJson(udoc));
+            serializeJson(udoc, publish);
             publish.send();
         }
     }
+    static uint32_t lastTopTalkers = 0;
+    DeviceTable *devices = bleScanner.devices();
+    if (devices && millis() - lastTopTalkers > 10000) {
+        lastTopTalkers = millis();
+        static DeviceInfo top[10];
+        uint64_t now = esp_timer_get_time();
+        size_t n = devices->topTalkers(top, 10, now);
+        JsonDocument tdoc;
+        JsonArray arr = tdoc.to<JsonArray>();
+        for (size_t i = 0; i < n; i++) {
+            const DeviceInfo &d = top[i];
+            char mac[13];
+            hexFormatMac(d.mac, mac, '\0');
+            JsonObject o = arr.add<JsonObject>();
+            o["mac"] = mac;
+            if (d.dev[0])
+                o["dev"] = d.dev;
+            o["rate"] = d.rate(now);
+            o["n"] = d.adverts;
+            o["decr"] = d.decodeRatio();
+            o["rssi"] = d.rssiMean;
+            o["rssisd"] = sqrtf(d.rssiVar);
+            JsonArray hist = o["ivl"].to<JsonArray>();
+            for (uint32_t c : d.intervalHist)
+                hist.add(c);
+        }
+        auto publish = mqtt.begin_publish("ble/$top", measureJson(tdoc));
+        serializeJson(tdoc, publish);
+        publish.send();
+    }
+    static uint32_t lastLatency = 0;
+    if (millis() - lastLatency > 10000) {
+        lastLatency = millis();
+        static const char *const stages[BLEScanner::STAGE_COUNT] = {
+            "admit", "queue", "decode", "output", "publish", "total"
+        };
+        JsonDocument ldoc;
+        for (size_t i = 0; i < BLEScanner::STAGE_COUNT; i++) {
+            BLEScanner::LatencyStats l = bleScanner.latency((BLEScanner::Stage)i);
+            JsonObject o = ldoc[stages[i]].to<JsonObject>();
+            o["n"] = l.count;
+            o["p50"] = l.p50Us;
+            o["p99"] = l.p99Us;
+            o["max"] = l.maxUs;
+        }
+        auto publish = mqtt.begin_publish("ble/$latency", measureJson(ldoc));
+        serializeJson(ldoc, publish);
+        publish.send();
+    }
     mqtt.loop();
     yield();
 }
\ No newline at end of file
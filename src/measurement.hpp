@@ -0,0 +1,148 @@
+/// @file measurement.hpp
+/// @brief Typed decoder output: device kind plus a fixed array of fields.
+///
+/// Decoders fill a Measurement instead of a JSON document, so consumers
+/// on the decode side (device table, UI, a MeasurementSink) read values
+/// directly and JSON is produced only where adverts leave the scanner.
+/// Keys, units and text values point to static strings; a Measurement is
+/// trivially copyable and never allocates.
+///
+/// Pure C++, builds on the host.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+struct AdvRecord;
+
+static constexpr size_t MEASUREMENT_MAX_FIELDS = 24;
+
+enum class FieldType : uint8_t {
+    Float,
+    Double,   ///< values the decoders have always published at double precision
+    Int,
+    Uint,
+    Bool,
+    Text,     ///< static string
+    UintText, ///< unsigned number published as a decimal string (IDs, serials)
+};
+
+/// Measurement flags.
+enum : uint8_t {
+    MEASUREMENT_BTHOME = 0x01, ///< BTHome object list: objectId and unit are set
+};
+
+struct MeasurementField {
+    const char *key;  ///< static string, the published name
+    const char *unit; ///< static string, nullptr if none
+    uint8_t objectId; ///< BTHome object ID
+    FieldType type;
+    union {
+        float f;
+        double d;
+        int32_t i;
+        uint32_t u;
+        bool b;
+        const char *s;
+    };
+
+    /// Numeric value as float; false for Bool and Text fields.
+    bool number(float &out) const {
+        switch (type) {
+            case FieldType::Float:
+                out = f;
+                return true;
+            case FieldType::Double:
+                out = (float)d;
+                return true;
+            case FieldType::Int:
+                out = (float)i;
+                return true;
+            case FieldType::Uint:
+                out = (float)u;
+                return true;
+            default:
+                return false;
+        }
+    }
+};
+
+struct Measurement {
+    const char *dev = nullptr; ///< device kind, static string; nullptr for BTHome
+    uint8_t flags = 0;
+    uint8_t version = 0;       ///< BTHome protocol version
+    uint8_t count = 0;
+    uint8_t dropped = 0;       ///< fields beyond MEASUREMENT_MAX_FIELDS
+    MeasurementField fields[MEASUREMENT_MAX_FIELDS];
+
+    void addFloat(const char *key, float v) {
+        if (MeasurementField *m = add(key, FieldType::Float))
+            m->f = v;
+    }
+    void addDouble(const char *key, double v) {
+        if (MeasurementField *m = add(key, FieldType::Double))
+            m->d = v;
+    }
+    void addInt(const char *key, int32_t v) {
+        if (MeasurementField *m = add(key, FieldType::Int))
+            m->i = v;
+    }
+    void addUint(const char *key, uint32_t v) {
+        if (MeasurementField *m = add(key, FieldType::Uint))
+            m->u = v;
+    }
+    void addBool(const char *key, bool v) {
+        if (MeasurementField *m = add(key, FieldType::Bool))
+            m->b = v;
+    }
+    void addText(const char *key, const char *v) {
+        if (MeasurementField *m = add(key, FieldType::Text))
+            m->s = v;
+    }
+    void addUintText(const char *key, uint32_t v) {
+        if (MeasurementField *m = add(key, FieldType::UintText))
+            m->u = v;
+    }
+
+    /// BTHome object: name and unit from the object table.
+    void addObject(uint8_t objectId, const char *name, const char *unit, float v) {
+        if (MeasurementField *m = add(name, FieldType::Float)) {
+            m->objectId = objectId;
+            m->unit = unit;
+            m->f = v;
+        }
+    }
+
+    /// Field by key, or nullptr.
+    const MeasurementField *find(const char *key) const {
+        for (size_t i = 0; i < count; i++)
+            if (strcmp(fields[i].key, key) == 0)
+                return &fields[i];
+        return nullptr;
+    }
+
+private:
+    MeasurementField *add(const char *key, FieldType type) {
+        if (count >= MEASUREMENT_MAX_FIELDS) {
+            if (dropped < UINT8_MAX)
+                dropped++;
+            return nullptr;
+        }
+        MeasurementField &m = fields[count++];
+        m.key = key;
+        m.unit = nullptr;
+        m.objectId = 0;
+        m.type = type;
+        return &m;
+    }
+};
+
+/// Receives every decoded advert on the decode side (process() or a decode
+/// worker) before it is serialized; see BLEScanner::setMeasurementSink().
+/// Runs on the decoding task and must not block.
+class MeasurementSink {
+public:
+    virtual ~MeasurementSink() = default;
+    virtual void onMeasurement(const AdvRecord &rec, const Measurement &m) = 0;
+};
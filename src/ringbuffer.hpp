@@ -5,9 +5,22 @@
     #include "freertos/ringbuf.h"
 #endif
 
+#include <atomic>
+
+#include "esp_heap_caps.h"
+#include "itemqueue.hpp"
+
 namespace espidf {
 
-class RingBuffer {
+/// Raise a high water mark shared between the producer and reset callers.
+inline void raise_watermark(std::atomic<size_t> &hwm, size_t usage) {
+    size_t cur = hwm.load(std::memory_order_relaxed);
+    while (usage > cur &&
+            !hwm.compare_exchange_weak(cur, usage, std::memory_order_relaxed))
+        ;
+}
+
+class RingBuffer : public ItemQueue {
 
   public:
 
@@ -18,7 +31,7 @@ class RingBuffer {
         h = xRingbufferCreate(sz, type);
 #endif
         total_size = sz;
-        high_watermark = 0;
+        high_watermark.store(0, std::memory_order_relaxed);
     }
 
     void create(size_t sz, RingbufferType_t type,
@@ -26,7 +39,7 @@ class RingBuffer {
                 StaticRingbuffer_t* pxStaticRingbuffer) {
         h = xRingbufferCreateStatic(sz, type, pucRingbufferStorage, pxStaticRingbuffer);
         total_size = sz;
-        high_watermark = 0;
+        high_watermark.store(0, std::memory_order_relaxed);
     }
 
     void free() {
@@ -49,22 +62,33 @@ class RingBuffer {
         return xRingbufferSendFromISR(h, pvItem, xItemSize, pxHigherPriorityTaskWoke);
     }
 
-    BaseType_t send_acquire(void **ppvItem, size_t xItemSize, TickType_t xTicksToWait) {
-        return xRingbufferSendAcquire(h, ppvItem, xItemSize, xTicksToWait);
+    bool send_acquire(void **ppvItem, size_t xItemSize, uint32_t waitMs) override {
+        return xRingbufferSendAcquire(h, ppvItem, xItemSize, pdMS_TO_TICKS(waitMs)) == pdTRUE;
     }
 
-    BaseType_t send_complete(void *pvItem) {
-        return xRingbufferSendComplete(h, pvItem);
+    bool send_complete(void *pvItem) override {
+        return xRingbufferSendComplete(h, pvItem) == pdTRUE;
     }
 
-    void* receive(size_t* sz,  TickType_t xTicksToWait) {
-        return xRingbufferReceive(h, sz, xTicksToWait);
+    void* receive(size_t* sz, uint32_t waitMs) override {
+        return xRingbufferReceive(h, sz, pdMS_TO_TICKS(waitMs));
     }
 
-    void return_item(void* pvItem) {
+    void return_item(void* pvItem) override {
         vRingbufferReturnItem(h, pvItem);
     }
 
+    bool discard_oldest() override {
+        // NOSPLIT items may be returned out of order, so the producer can
+        // take and free the oldest unread item while the consumer holds one.
+        size_t sz;
+        void *item = xRingbufferReceive(h, &sz, 0);
+        if (item == nullptr)
+            return false;
+        vRingbufferReturnItem(h, item);
+        return true;
+    }
+
     void* receive_from_isr(size_t* sz) {
         return xRingbufferReceiveFromISR(h, sz);
     }
@@ -73,27 +97,26 @@ class RingBuffer {
         vRingbufferReturnItemFromISR(h, pvItem, pxHigherPriorityTaskWoken);
     }
 
-    size_t get_current_usage() const {
+    size_t get_current_usage() const override {
         return total_size - xRingbufferGetCurFreeSize(h);
     }
 
-    size_t get_high_watermark() const {
-        return high_watermark;
+    size_t get_high_watermark() const override {
+        return high_watermark.load(std::memory_order_relaxed);
     }
 
-    size_t get_total_size() const {
+    size_t get_total_size() const override {
         return total_size;
     }
 
-    void update_high_watermark() {
+    size_t update_high_watermark() override {
         size_t current_usage = get_current_usage();
-        if (current_usage > high_watermark) {
-            high_watermark = current_usage;
-        }
+        raise_watermark(high_watermark, current_usage);
+        return current_usage;
     }
 
-    void reset_high_watermark() {
-        high_watermark = 0;
+    void reset_high_watermark() override {
+        high_watermark.store(0, std::memory_order_relaxed);
     }
 
     operator RingbufHandle_t() const {
@@ -103,7 +126,185 @@ class RingBuffer {
   private:
     RingbufHandle_t h;
     size_t total_size;
-    size_t high_watermark;
+    std::atomic<size_t> high_watermark{0};
+
+};
+
+/// Two NOSPLIT ring buffers behind one queue: a small fast tier (internal
+/// SRAM by default) takes all traffic while it has room, and bursts spill
+/// into a large tier (PSRAM by default). Once an item has spilled, new items
+/// keep going to the spill tier until the consumer has received every
+/// spilled item, so receive order is always send order. Items are returned
+/// to the tier whose storage they point into.
+///
+/// Single producer, single consumer. The producer must not hold more than
+/// one acquired item at a time.
+class TieredRingBuffer : public ItemQueue {
+
+  public:
+
+    ~TieredRingBuffer() override {
+        free();
+    }
+
+    bool create(size_t fastSize, size_t spillSize,
+                UBaseType_t fastCap = MALLOC_CAP_INTERNAL,
+                UBaseType_t spillCap = MALLOC_CAP_SPIRAM) {
+        return fast.create(fastSize, fastCap) && spill.create(spillSize, spillCap);
+    }
+
+    void free() {
+        fast.free();
+        spill.free();
+    }
+
+    bool send_acquire(void **ppvItem, size_t xItemSize, uint32_t waitMs) override {
+        if (spill_pending.load(std::memory_order_acquire) == 0 &&
+                fast.ring.send_acquire(ppvItem, xItemSize, 0)) {
+            return true;
+        }
+        if (!spill.ring.send_acquire(ppvItem, xItemSize, waitMs))
+            return false;
+        // counted before send_complete so the consumer knows to look there
+        spill_pending.fetch_add(1, std::memory_order_release);
+        spilled_items.fetch_add(1, std::memory_order_relaxed);
+        spilled_bytes.fetch_add(xItemSize, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool send_complete(void *pvItem) override {
+        return tier_of(pvItem).ring.send_complete(pvItem);
+    }
+
+    void* receive(size_t* sz, uint32_t waitMs) override {
+        while (true) {
+            // everything in the fast tier predates the spilled items
+            void *item = fast.ring.receive(sz, 0);
+            if (item)
+                return item;
+
+            uint32_t slice = waitMs < POLL_MS ? waitMs : POLL_MS;
+            if (spill_pending.load(std::memory_order_acquire)) {
+                // The producer may have filled the fast tier and spilled
+                // since the look above; what it sent before spilling is
+                // visible now and comes first.
+                item = fast.ring.receive(sz, 0);
+                if (item)
+                    return item;
+                item = spill.ring.receive(sz, slice);
+                if (item) {
+                    spill_pending.fetch_sub(1, std::memory_order_release);
+                    return item;
+                }
+            } else {
+                item = fast.ring.receive(sz, slice);
+                if (item)
+                    return item;
+            }
+            if (waitMs == slice)
+                return nullptr;
+            waitMs -= slice;
+        }
+    }
+
+    void return_item(void* pvItem) override {
+        tier_of(pvItem).ring.return_item(pvItem);
+    }
+
+    /// Drops the oldest item: from the fast tier while it holds any (its
+    /// items predate every spilled one), then from the spill tier.
+    bool discard_oldest() override {
+        if (fast.ring.discard_oldest())
+            return true;
+        if (spill_pending.load(std::memory_order_acquire) == 0 ||
+                !spill.ring.discard_oldest())
+            return false;
+        spill_pending.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    size_t get_current_usage() const override {
+        return fast.ring.get_current_usage() + spill.ring.get_current_usage();
+    }
+
+    size_t get_high_watermark() const override {
+        return high_watermark.load(std::memory_order_relaxed);
+    }
+
+    size_t get_total_size() const override {
+        return fast.ring.get_total_size() + spill.ring.get_total_size();
+    }
+
+    size_t update_high_watermark() override {
+        size_t current_usage = fast.ring.update_high_watermark() +
+                               spill.ring.update_high_watermark();
+        raise_watermark(high_watermark, current_usage);
+        return current_usage;
+    }
+
+    void reset_high_watermark() override {
+        fast.ring.reset_high_watermark();
+        spill.ring.reset_high_watermark();
+        high_watermark.store(0, std::memory_order_relaxed);
+    }
+
+    /// Items and bytes that went to the spill tier since create().
+    uint32_t get_spilled_items() const {
+        return spilled_items.load(std::memory_order_relaxed);
+    }
+    uint64_t get_spilled_bytes() const {
+        return spilled_bytes.load(std::memory_order_relaxed);
+    }
+
+    const RingBuffer &fast_tier() const {
+        return fast.ring;
+    }
+    const RingBuffer &spill_tier() const {
+        return spill.ring;
+    }
+
+  private:
+    static constexpr uint32_t POLL_MS = 10;
+
+    // A ring buffer over storage we allocate, so item addresses identify it.
+    struct Tier {
+        RingBuffer ring;
+        uint8_t *storage = nullptr;
+        size_t size = 0;
+        StaticRingbuffer_t control;
+
+        bool create(size_t sz, UBaseType_t cap) {
+            size = (sz + 3) & ~(size_t)3; // NOSPLIT storage is word aligned
+            storage = static_cast<uint8_t *>(heap_caps_malloc(size, cap));
+            if (!storage)
+                return false;
+            ring.create(size, RINGBUF_TYPE_NOSPLIT, storage, &control);
+            return true;
+        }
+
+        void free() {
+            if (!storage)
+                return;
+            ring.free();
+            heap_caps_free(storage);
+            storage = nullptr;
+        }
+
+        bool contains(const void *p) const {
+            return p >= storage && p < storage + size;
+        }
+    };
+
+    Tier &tier_of(const void *pvItem) {
+        return fast.contains(pvItem) ? fast : spill;
+    }
+
+    Tier fast;
+    Tier spill;
+    std::atomic<uint32_t> spill_pending{0};
+    std::atomic<uint32_t> spilled_items{0};
+    std::atomic<uint64_t> spilled_bytes{0};
+    std::atomic<size_t> high_watermark{0};
 
 };
 
@@ -0,0 +1,204 @@
+/// @file spscqueue.hpp
+/// @brief Lock-free single-producer/single-consumer variable-length item queue.
+///
+/// Same zero-copy acquire/complete/receive/return contract as the NOSPLIT
+/// ESP-IDF ring buffer (see itemqueue.hpp), but without a critical section:
+/// the producer owns the head index, the consumer owns the tail index, and
+/// both are published with release/acquire atomics on separate cache lines.
+/// Each side also caches the other's index and only reloads it when the
+/// cached value says the queue is full (producer) or empty (consumer).
+///
+/// Layout: every item is an 8-byte header {len, end} followed by the
+/// payload, padded to 8 bytes. `end` is the free-running index just past the
+/// item, so return_item() can publish the new tail without any bookkeeping.
+/// When an item does not fit before the end of the buffer, a padding header
+/// covers the remainder and the item starts at offset 0 (items never split).
+///
+/// Exactly one task may send and exactly one task may receive. Received items
+/// must be returned in the order they were received. Waiting (waitMs > 0)
+/// polls with a 1 ms sleep since there is no blocking primitive.
+///
+/// Pure C++ apart from the optional heap_caps allocation, so it builds and
+/// can be benchmarked on the host.
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+
+#ifdef ESP_PLATFORM
+    #include "esp_heap_caps.h"
+#endif
+
+#include "itemqueue.hpp"
+
+class SpscQueue : public ItemQueue {
+public:
+    SpscQueue() = default;
+    ~SpscQueue() override {
+        free();
+    }
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    /// Allocate the buffer; sz is rounded down to a power of two (min 64).
+    /// caps selects the heap on ESP-IDF (MALLOC_CAP_*), ignored elsewhere.
+    bool create(size_t sz, uint32_t caps = 0) {
+        size_t cap = 64;
+        while (cap * 2 <= sz && cap < (1u << 30))
+            cap *= 2;
+#ifdef ESP_PLATFORM
+        _buf = static_cast<uint8_t *>(heap_caps_malloc(cap, caps ? caps : MALLOC_CAP_DEFAULT));
+#else
+        (void)caps;
+        _buf = static_cast<uint8_t *>(std::malloc(cap));
+#endif
+        if (!_buf)
+            return false;
+        _mask = (uint32_t)cap - 1;
+        _head.store(0, std::memory_order_relaxed);
+        _tail.store(0, std::memory_order_relaxed);
+        _hwm.store(0, std::memory_order_relaxed);
+        _tailCache = _pending = _headCache = _read = 0;
+        return true;
+    }
+
+    void free() {
+#ifdef ESP_PLATFORM
+        heap_caps_free(_buf);
+#else
+        std::free(_buf);
+#endif
+        _buf = nullptr;
+    }
+
+    /// Largest payload a single item can carry. Half the buffer, so an item
+    /// plus the padding before it always fits once the queue drains.
+    size_t max_item_size() const {
+        return (_mask + 1) / 2 - sizeof(Header);
+    }
+
+    bool send_acquire(void **item, size_t size, uint32_t waitMs) override {
+        uint32_t cap = _mask + 1;
+        if (size > max_item_size())
+            return false;
+        uint32_t need = span(size);
+        auto deadline = clock::now() + std::chrono::milliseconds(waitMs);
+
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        uint32_t contig = cap - (head & _mask);
+        uint32_t pad = need > contig ? contig : 0;
+
+        while (cap - (head - _tailCache) < pad + need) {
+            _tailCache = _tail.load(std::memory_order_acquire);
+            if (cap - (head - _tailCache) >= pad + need)
+                break;
+            if (clock::now() >= deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        if (pad) {
+            Header *p = at(head);
+            p->len = PAD;
+            p->end = head + pad;
+        }
+        Header *h = at(head + pad);
+        h->len = (uint32_t)size;
+        h->end = head + pad + need;
+        _pending = h->end;
+        *item = h + 1;
+        return true;
+    }
+
+    bool send_complete(void *item) override {
+        (void)item;
+        _head.store(_pending, std::memory_order_release);
+
+        uint32_t used = _pending - _tail.load(std::memory_order_relaxed);
+        uint32_t hwm = _hwm.load(std::memory_order_relaxed);
+        while (used > hwm &&
+                !_hwm.compare_exchange_weak(hwm, used, std::memory_order_relaxed))
+            ;
+        return true;
+    }
+
+    void *receive(size_t *size, uint32_t waitMs) override {
+        auto deadline = clock::now() + std::chrono::milliseconds(waitMs);
+        while (true) {
+            if (_read == _headCache) {
+                _headCache = _head.load(std::memory_order_acquire);
+                if (_read == _headCache) {
+                    if (clock::now() >= deadline)
+                        return nullptr;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    continue;
+                }
+            }
+            Header *h = at(_read);
+            _read = h->end;
+            if (h->len == PAD)
+                continue;
+            *size = h->len;
+            return h + 1;
+        }
+    }
+
+    void return_item(void *item) override {
+        const Header *h = static_cast<const Header *>(item) - 1;
+        _tail.store(h->end, std::memory_order_release);
+    }
+
+    size_t get_current_usage() const override {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    size_t get_high_watermark() const override {
+        return _hwm.load(std::memory_order_relaxed);
+    }
+
+    size_t get_total_size() const override {
+        return _buf ? _mask + 1 : 0;
+    }
+
+    void reset_high_watermark() override {
+        _hwm.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct Header {
+        uint32_t len; ///< payload bytes, or PAD
+        uint32_t end; ///< free-running index just past this item
+    };
+    static constexpr uint32_t PAD = 0xFFFFFFFFu;
+    static constexpr size_t CACHE_LINE = 64;
+
+    static uint32_t span(size_t size) {
+        return (uint32_t)((sizeof(Header) + size + 7) & ~(size_t)7);
+    }
+
+    Header *at(uint32_t index) const {
+        return reinterpret_cast<Header *>(_buf + (index & _mask));
+    }
+
+    // shared, read-only after create()
+    uint8_t *_buf = nullptr;
+    uint32_t _mask = 0;
+
+    // producer side
+    alignas(CACHE_LINE) std::atomic<uint32_t> _head{0};
+    uint32_t _tailCache = 0;
+    uint32_t _pending = 0;
+
+    // consumer side
+    alignas(CACHE_LINE) std::atomic<uint32_t> _tail{0};
+    uint32_t _headCache = 0;
+    uint32_t _read = 0;
+
+    alignas(CACHE_LINE) std::atomic<uint32_t> _hwm{0};
+};
@@ -0,0 +1,54 @@
+/// @file bench.hpp
+/// @brief Timing for the host microbenchmarks (test/test_bench_*).
+///
+/// Time is counted in TSC cycles on x86 and in nanoseconds elsewhere;
+/// BENCH_UNIT names the unit. The TSC ticks at a fixed rate that need not
+/// match the core clock, so compare figures from one machine only.
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define BENCH_UNIT "cycle"
+inline uint64_t benchTicks() {
+    return __rdtsc();
+}
+#else
+    #define BENCH_UNIT "ns"
+inline uint64_t benchTicks() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+/// Results are folded in here so the compiler cannot drop the work.
+inline volatile uint32_t benchSink;
+
+/// Ticks per call of fn(i), the best of `runs` runs of `iters` calls.
+template <typename F>
+double benchPerCall(size_t iters, F &&fn, int runs = 7) {
+    double best = 0;
+    for (int r = 0; r < runs; r++) {
+        uint64_t t0 = benchTicks();
+        for (size_t i = 0; i < iters; i++)
+            fn(i);
+        double t = double(benchTicks() - t0) / iters;
+        if (r == 0 || t < best)
+            best = t;
+    }
+    return best;
+}
+
+/// Print one result line: name, ticks per call and, unless bytes is 0,
+/// bytes per tick.
+inline void benchReport(const char *name, double ticks, size_t bytes = 0) {
+    if (bytes)
+        printf("%-32s %9.1f %s/call %7.3f bytes/%s\n",
+               name, ticks, BENCH_UNIT, bytes / ticks, BENCH_UNIT);
+    else
+        printf("%-32s %9.1f %s/call\n", name, ticks, BENCH_UNIT);
+}
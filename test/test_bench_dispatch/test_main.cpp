@@ -0,0 +1,157 @@
+// Microbenchmark of decoder dispatch: the registry lookup BLEScanner uses
+// (decoderregistry.hpp) against the switch it replaced, over a stream of
+// company IDs and service data UUIDs in which most adverts have no decoder,
+// as in a typical scan. The tables hold the scanner's IDs with stand-in
+// decoders; the lookup cost does not depend on what the decoders do. Both
+// dispatches are first checked to agree on every 16-bit ID.
+//
+//   pio test -e native_bench -f test_bench_dispatch
+
+#include "decoderregistry.hpp"
+#include "../bench.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <unity.h>
+
+using Decoder = bool (*)(const uint8_t *data, size_t len);
+
+template <int K>
+__attribute__((noinline)) static bool decoder(const uint8_t *data, size_t len) {
+    return len > K && data[0];
+}
+
+// ---------------------------------------------------------------------------
+// The replaced dispatch
+// ---------------------------------------------------------------------------
+namespace old {
+
+static constexpr uint16_t BTHOME_UUID = 0xFCD2;
+
+static Decoder mfdDecoderFor(uint16_t companyId) {
+    switch (companyId) {
+        case 0x0499:
+            return decoder<0>;
+        case 0x0059:
+            return decoder<1>;
+        case 0x0100:
+            return decoder<2>;
+        case 0x00AC:
+            return decoder<3>;
+        case 0x03B1:
+            return decoder<4>;
+        case 0xffff:
+            return decoder<5>;
+        case 0x094f:
+            return decoder<6>;
+    }
+    return nullptr;
+}
+
+static Decoder serviceDecoderFor(uint16_t uuid) {
+    return uuid == BTHOME_UUID ? decoder<7> : nullptr;
+}
+
+} // namespace old
+
+// ---------------------------------------------------------------------------
+// The registry, with the scanner's tables
+// ---------------------------------------------------------------------------
+static constexpr DecoderEntry<Decoder> MFD_DECODERS[] = {
+    {0x0000, nullptr},
+    {0x0059, decoder<1>},
+    {0x00AC, decoder<3>},
+    {0x0100, decoder<2>},
+    {0x03B1, decoder<4>},
+    {0x0499, decoder<0>},
+    {0x094F, decoder<6>},
+    {0xFFFF, decoder<5>},
+};
+
+static constexpr DecoderEntry<Decoder> SERVICE_DECODERS[] = {
+    {0x0000, nullptr},
+    {0xFCD2, decoder<7>},
+};
+
+static_assert(sortedById(MFD_DECODERS), "MFD_DECODERS must be sorted by company ID");
+static_assert(sortedById(SERVICE_DECODERS), "SERVICE_DECODERS must be sorted by UUID");
+
+// ---------------------------------------------------------------------------
+// Benchmarks
+// ---------------------------------------------------------------------------
+static constexpr size_t STREAM = 4096;
+static uint16_t s_companies[STREAM];
+static uint16_t s_uuids[STREAM];
+
+// Roughly one advert in four from a device with a decoder
+static void fillStreams() {
+    static const uint16_t known[] = {0x0499, 0x0059, 0x0100, 0x00AC, 0x03B1, 0xFFFF, 0x094F};
+    static const uint16_t unknownCompanies[] = {0x004C, 0x0006, 0x00E0, 0x0075, 0x0087, 0x02E5};
+    static const uint16_t unknownUuids[] = {0xFE9F, 0xFEAA, 0xFD6F, 0x181A, 0xFE2C};
+    srand(1);
+    for (size_t i = 0; i < STREAM; i++) {
+        bool hit = rand() % 4 == 0;
+        s_companies[i] = hit ? known[rand() % 7] : unknownCompanies[rand() % 6];
+        s_uuids[i] = hit ? 0xFCD2 : unknownUuids[rand() % 5];
+    }
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_bench_company_id() {
+    for (uint32_t id = 0; id <= 0xFFFF; id++)
+        TEST_ASSERT_TRUE(findDecoder(MFD_DECODERS, id) == old::mfdDecoderFor(id));
+
+    double tOld = benchPerCall(2000000, [](size_t i) {
+        benchSink = benchSink + (uintptr_t)old::mfdDecoderFor(s_companies[i % STREAM]);
+    });
+    double tNew = benchPerCall(2000000, [](size_t i) {
+        benchSink = benchSink + (uintptr_t)findDecoder(MFD_DECODERS, s_companies[i % STREAM]);
+    });
+    printf("company ID lookup\n");
+    benchReport("  switch", tOld);
+    benchReport("  registry", tNew);
+}
+
+static void test_bench_service_uuid() {
+    for (uint32_t id = 0; id <= 0xFFFF; id++)
+        TEST_ASSERT_TRUE(findDecoder(SERVICE_DECODERS, id) == old::serviceDecoderFor(id));
+
+    double tOld = benchPerCall(2000000, [](size_t i) {
+        benchSink = benchSink + (uintptr_t)old::serviceDecoderFor(s_uuids[i % STREAM]);
+    });
+    double tNew = benchPerCall(2000000, [](size_t i) {
+        benchSink = benchSink + (uintptr_t)findDecoder(SERVICE_DECODERS, s_uuids[i % STREAM]);
+    });
+    printf("service data UUID lookup\n");
+    benchReport("  BTHome UUID compare", tOld);
+    benchReport("  registry", tNew);
+}
+
+// Lookup plus the indirect call, as deliver() does it
+static void test_bench_dispatch_and_call() {
+    static const uint8_t data[4] = {1, 2, 3, 4};
+    double tOld = benchPerCall(2000000, [](size_t i) {
+        Decoder d = old::mfdDecoderFor(s_companies[i % STREAM]);
+        benchSink = benchSink + (d && d(data, sizeof(data)));
+    });
+    double tNew = benchPerCall(2000000, [](size_t i) {
+        Decoder d = findDecoder(MFD_DECODERS, s_companies[i % STREAM]);
+        benchSink = benchSink + (d && d(data, sizeof(data)));
+    });
+    printf("company ID lookup and call\n");
+    benchReport("  switch", tOld);
+    benchReport("  registry", tNew);
+}
+
+int main() {
+    fillStreams();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_bench_company_id);
+    RUN_TEST(test_bench_service_uuid);
+    RUN_TEST(test_bench_dispatch_and_call);
+    return UNITY_END();
+}
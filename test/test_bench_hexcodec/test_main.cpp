@@ -0,0 +1,180 @@
+// Microbenchmark of hexcodec.hpp against the helpers it replaced, on the
+// payload sizes the scanner sees (a MAC, a 31-byte advert, a 255-byte
+// extended advert). Each case first checks that old and new produce the
+// same output.
+//
+//   pio test -e native_bench -f test_bench_hexcodec
+
+#include "hexcodec.hpp"
+#include "../bench.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unity.h>
+
+// ---------------------------------------------------------------------------
+// The replaced helpers; std::string stands in for Arduino's String
+// ---------------------------------------------------------------------------
+namespace old {
+
+static void bytesToHexString(const uint8_t *data, size_t len, std::string &hexStr) {
+    static const char HEX_CHARS[] = "0123456789ABCDEF";
+    hexStr = "";
+    if (len == 0)
+        return;
+    hexStr.reserve(len * 2);
+    for (size_t i = 0; i < len; i++) {
+        hexStr += HEX_CHARS[data[i] >> 4];
+        hexStr += HEX_CHARS[data[i] & 0x0F];
+    }
+}
+
+// BTHome key: strtol over two-character substrings
+static void hexStringToBytes(const char *hex, size_t len, uint8_t *out) {
+    for (size_t i = 0; i < len / 2; i++) {
+        std::string sub(hex + i * 2, 2);
+        out[i] = (uint8_t)strtol(sub.c_str(), nullptr, 16);
+    }
+}
+
+// AdvFilter: branching nibble conversion
+static int hexNibble(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c = toupper((unsigned char)c);
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static bool nibbleDecode(const char *hex, size_t len, uint8_t *out) {
+    if (len & 1)
+        return false;
+    for (size_t i = 0; i < len / 2; i++) {
+        int hi = hexNibble(hex[2 * i]);
+        int lo = hexNibble(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0)
+            return false;
+        out[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return true;
+}
+
+static void formatMac(const uint8_t mac[6], char *out, size_t outLen) {
+    snprintf(out, outLen, "%02X:%02X:%02X:%02X:%02X:%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+} // namespace old
+
+// ---------------------------------------------------------------------------
+// Benchmarks
+// ---------------------------------------------------------------------------
+static constexpr size_t SIZES[] = {6, 31, 255};
+static uint8_t s_data[255];
+static char s_hex[2 * 255 + 1];
+
+static size_t iterations(size_t len) {
+    return 2000000 / (len + 8);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_bench_encode() {
+    printf("encode (HEXCODEC_VECTOR=%d)\n", HEXCODEC_VECTOR);
+    for (size_t len : SIZES) {
+        std::string str;
+        char out[2 * 255 + 1];
+        old::bytesToHexString(s_data, len, str);
+        hexEncode(s_data, len, out);
+        TEST_ASSERT_EQUAL_STRING(str.c_str(), out);
+
+        size_t n = iterations(len);
+        double tOld = benchPerCall(n, [&](size_t i) {
+            s_data[0] = (uint8_t)i;
+            old::bytesToHexString(s_data, len, str);
+            benchSink = benchSink + (uint8_t)str[len];
+        });
+        double tNew = benchPerCall(n, [&](size_t i) {
+            s_data[0] = (uint8_t)i;
+            hexEncode(s_data, len, out);
+            benchSink = benchSink + (uint8_t)out[len];
+        });
+        char name[48];
+        snprintf(name, sizeof(name), "  bytesToHexString %3u B", (unsigned)len);
+        benchReport(name, tOld, len);
+        snprintf(name, sizeof(name), "  hexEncode        %3u B", (unsigned)len);
+        benchReport(name, tNew, len);
+    }
+}
+
+static void test_bench_decode() {
+    printf("decode\n");
+    for (size_t len : SIZES) {
+        size_t chars = 2 * len;
+        uint8_t a[255], b[255], c[255];
+        old::hexStringToBytes(s_hex, chars, a);
+        TEST_ASSERT_TRUE(old::nibbleDecode(s_hex, chars, b));
+        TEST_ASSERT_TRUE(hexDecode(s_hex, chars, c));
+        TEST_ASSERT_EQUAL_MEMORY(a, c, len);
+        TEST_ASSERT_EQUAL_MEMORY(b, c, len);
+
+        size_t n = iterations(len);
+        double tStrtol = benchPerCall(n / 4, [&](size_t) {
+            old::hexStringToBytes(s_hex, chars, a);
+            benchSink = benchSink + a[len - 1];
+        });
+        double tNibble = benchPerCall(n, [&](size_t) {
+            benchSink = benchSink + old::nibbleDecode(s_hex, chars, b) + b[len - 1];
+        });
+        double tNew = benchPerCall(n, [&](size_t) {
+            benchSink = benchSink + hexDecode(s_hex, chars, c) + c[len - 1];
+        });
+        char name[48];
+        snprintf(name, sizeof(name), "  strtol substrings %3u B", (unsigned)len);
+        benchReport(name, tStrtol, len);
+        snprintf(name, sizeof(name), "  branching nibbles %3u B", (unsigned)len);
+        benchReport(name, tNibble, len);
+        snprintf(name, sizeof(name), "  hexDecode         %3u B", (unsigned)len);
+        benchReport(name, tNew, len);
+    }
+}
+
+static void test_bench_format_mac() {
+    printf("MAC formatting\n");
+    char a[18], b[18];
+    old::formatMac(s_data, a, sizeof(a));
+    hexFormatMac(s_data, b);
+    TEST_ASSERT_EQUAL_STRING(a, b);
+
+    double tOld = benchPerCall(200000, [&](size_t i) {
+        s_data[5] = (uint8_t)i;
+        old::formatMac(s_data, a, sizeof(a));
+        benchSink = benchSink + (uint8_t)a[16];
+    });
+    double tNew = benchPerCall(200000, [&](size_t i) {
+        s_data[5] = (uint8_t)i;
+        hexFormatMac(s_data, b);
+        benchSink = benchSink + (uint8_t)b[16];
+    });
+    benchReport("  snprintf", tOld, 6);
+    benchReport("  hexFormatMac", tNew, 6);
+}
+
+int main() {
+    srand(1);
+    for (uint8_t &b : s_data)
+        b = (uint8_t)rand();
+    hexEncode(s_data, sizeof(s_data), s_hex, true);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_bench_encode);
+    RUN_TEST(test_bench_decode);
+    RUN_TEST(test_bench_format_mac);
+    return UNITY_END();
+}
@@ -0,0 +1,222 @@
+// parseBTHomeV2() with a caller buffer must not touch the heap, neither for
+// plain packets nor for encrypted ones decrypted with a key store context.
+// Every operator new and (with glibc) every malloc/calloc/realloc is
+// counted while the decoder runs.
+//
+//   pio test -e native -f test_bthome_alloc
+
+#include "BTHomeDecoder.h"
+#include "BTHomeKeyStore.h"
+#include "mbedtls/ccm.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <unity.h>
+
+// ---------------------------------------------------------------------------
+// Allocation counting
+// ---------------------------------------------------------------------------
+static std::atomic<size_t> s_allocs{0};
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_calloc(size_t, size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+
+extern "C" void *malloc(size_t size) {
+    s_allocs++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size) {
+    s_allocs++;
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *p, size_t size) {
+    s_allocs++;
+    return __libc_realloc(p, size);
+}
+
+static void *rawAlloc(size_t size) {
+    return __libc_malloc(size ? size : 1);
+}
+#else
+static void *rawAlloc(size_t size) {
+    return std::malloc(size ? size : 1);
+}
+#endif
+
+void *operator new(size_t size) {
+    s_allocs++;
+    if (void *p = rawAlloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    s_allocs++;
+    return rawAlloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    std::free(p);
+}
+
+// ---------------------------------------------------------------------------
+// Packets
+// ---------------------------------------------------------------------------
+static const uint8_t MAC[6] = {0x54, 0x48, 0xE6, 0x8F, 0x80, 0xA5};
+static const uint8_t KEY[16] = {
+    0x23, 0x1d, 0x39, 0xc1, 0xd7, 0xcc, 0x1a, 0xb1,
+    0xae, 0xe2, 0x24, 0xcd, 0x09, 0x6d, 0xb9, 0x32,
+};
+
+// Objects of both packets: battery 93 %, temperature 25.06 °C
+static const uint8_t OBJECTS[] = {0x01, 0x5D, 0x02, 0xCA, 0x09};
+
+// Service data after the 0xFCD2 UUID, unencrypted
+static const uint8_t PLAIN_SD[] = {0x40, 0x01, 0x5D, 0x02, 0xCA, 0x09};
+
+// Encrypted: adv info | cipher | counter(4) | mic(4)
+static uint8_t s_encrypted[1 + sizeof(OBJECTS) + 8];
+
+static void encryptPacket() {
+    static const uint8_t counter[4] = {0x00, 0x11, 0x22, 0x33};
+    const uint8_t advInfo = 0x41;
+    uint8_t nonce[13];
+    memcpy(nonce, MAC, 6);
+    nonce[6] = 0xD2;
+    nonce[7] = 0xFC;
+    nonce[8] = advInfo;
+    memcpy(&nonce[9], counter, 4);
+
+    uint8_t *p = s_encrypted;
+    *p++ = advInfo;
+    mbedtls_ccm_context ctx;
+    mbedtls_ccm_init(&ctx);
+    mbedtls_ccm_setkey(&ctx, MBEDTLS_CIPHER_ID_AES, KEY, 128);
+    mbedtls_ccm_encrypt_and_tag(&ctx, sizeof(OBJECTS), nonce, sizeof(nonce), nullptr, 0,
+                                OBJECTS, p, p + sizeof(OBJECTS) + 4, 4);
+    mbedtls_ccm_free(&ctx);
+    memcpy(p + sizeof(OBJECTS), counter, 4);
+}
+
+// ---------------------------------------------------------------------------
+// Tests
+// ---------------------------------------------------------------------------
+static constexpr int ROUNDS = 100;
+
+static BTHomeDecoder s_decoder;
+static BTHomeKeyStore s_keys;
+static BTHomeMeasurement s_out[BTHOME_MAX_OBJECTS];
+
+static void checkResult(const BTHomeDecodeStatus &st) {
+    TEST_ASSERT_TRUE(st.isBTHomeV2);
+    TEST_ASSERT_TRUE(st.decryptionSucceeded);
+    TEST_ASSERT_EQUAL_size_t(2, st.count);
+    TEST_ASSERT_EQUAL_UINT8(0x01, s_out[0].objectID);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 93.0f, s_out[0].value);
+    TEST_ASSERT_EQUAL_UINT8(0x02, s_out[1].objectID);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 25.06f, s_out[1].value);
+}
+
+// Decode sd ROUNDS times after one warm-up call and return the number of
+// allocations made by the counted calls.
+static size_t countAllocs(const uint8_t *sd, size_t len, BTHomeDecodeStatus &st) {
+    st = s_decoder.parseBTHomeV2(sd, len, MAC, nullptr, s_out, BTHOME_MAX_OBJECTS);
+    size_t before = s_allocs.load();
+    for (int i = 0; i < ROUNDS; i++)
+        st = s_decoder.parseBTHomeV2(sd, len, MAC, nullptr, s_out, BTHOME_MAX_OBJECTS);
+    return s_allocs.load() - before;
+}
+
+void setUp() {
+    s_keys.clear();
+    s_keys.setDefaultKey(nullptr);
+}
+
+void tearDown() {}
+
+static void test_counter_sees_allocations() {
+    size_t before = s_allocs.load();
+    int *volatile p = new int(1);
+    void *volatile m = std::malloc(16);
+    delete p;
+    std::free(m);
+#ifdef __GLIBC__
+    TEST_ASSERT_EQUAL_size_t(2, s_allocs.load() - before);
+#else
+    TEST_ASSERT_EQUAL_size_t(1, s_allocs.load() - before);
+#endif
+}
+
+static void test_plain_does_not_allocate() {
+    BTHomeDecodeStatus st;
+    TEST_ASSERT_EQUAL_size_t(0, countAllocs(PLAIN_SD, sizeof(PLAIN_SD), st));
+    TEST_ASSERT_FALSE(st.isEncrypted);
+    checkResult(st);
+}
+
+static void test_encrypted_device_key_does_not_allocate() {
+    TEST_ASSERT_TRUE(s_keys.add(MAC, KEY));
+    BTHomeDecodeStatus st;
+    TEST_ASSERT_EQUAL_size_t(0, countAllocs(s_encrypted, sizeof(s_encrypted), st));
+    TEST_ASSERT_TRUE(st.isEncrypted);
+    checkResult(st);
+    TEST_ASSERT_EQUAL_UINT32(ROUNDS + 1, s_keys.stats().hits);
+}
+
+static void test_encrypted_default_key_does_not_allocate() {
+    TEST_ASSERT_TRUE(s_keys.setDefaultKey(KEY));
+    BTHomeDecodeStatus st;
+    TEST_ASSERT_EQUAL_size_t(0, countAllocs(s_encrypted, sizeof(s_encrypted), st));
+    checkResult(st);
+}
+
+static void test_wrong_key_fails_without_allocating() {
+    uint8_t wrong[16];
+    memcpy(wrong, KEY, sizeof(wrong));
+    wrong[0] ^= 0xff;
+    TEST_ASSERT_TRUE(s_keys.add(MAC, wrong));
+    BTHomeDecodeStatus st;
+    TEST_ASSERT_EQUAL_size_t(0, countAllocs(s_encrypted, sizeof(s_encrypted), st));
+    TEST_ASSERT_TRUE(st.isEncrypted);
+    TEST_ASSERT_FALSE(st.decryptionSucceeded);
+    TEST_ASSERT_EQUAL_size_t(0, st.count);
+}
+
+int main() {
+    encryptPacket();
+    s_decoder.setKeyStore(&s_keys);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_counter_sees_allocations);
+    RUN_TEST(test_plain_does_not_allocate);
+    RUN_TEST(test_encrypted_device_key_does_not_allocate);
+    RUN_TEST(test_encrypted_default_key_does_not_allocate);
+    RUN_TEST(test_wrong_key_fails_without_allocating);
+    return UNITY_END();
+}
@@ -0,0 +1,259 @@
+// Host test of the BLE pipeline: adverts go in through injectAdvert() and
+// come out of processBatch() as JSON, exercising the scanner's queue,
+// decoders, device table and unknown device summary.
+//
+//   pio test -e native -f test_pipeline
+
+#include "BLEScanner.h"
+#include "DeviceTable.h"
+#include "advrecord.hpp"
+
+#include <cstring>
+#include <string>
+#include <unity.h>
+
+// Ruuvi RAWv2: 24.3 °C, 53.49 %, 1000.44 hPa
+static const uint8_t RUUVI_AD[] = {
+    0x02, 0x01, 0x06,
+    0x1b, 0xff, 0x99, 0x04, 0x05, 0x12, 0xfc, 0x53, 0x94, 0xc3, 0x7c, 0x00, 0x04,
+    0xff, 0xfc, 0x04, 0x0c, 0xac, 0x36, 0x42, 0x00, 0xcd, 0xcb, 0xb8, 0x33, 0x4c,
+    0x88, 0x4f,
+};
+
+// Unencrypted BTHome v2: battery 93 %, temperature 25.06 °C
+static const uint8_t BTHOME_AD[] = {
+    0x02, 0x01, 0x06,
+    0x09, 0x16, 0xD2, 0xFC, 0x40, 0x01, 0x5D, 0x02, 0xCA, 0x09,
+};
+
+// Manufacturer data of a company no decoder handles
+static const uint8_t UNKNOWN_AD[] = {
+    0x02, 0x01, 0x06,
+    0x05, 0xff, 0x34, 0x12, 0xde, 0xad,
+};
+
+// Scan response carrying just a complete local name, "Ruuvi 0001"
+static const uint8_t NAME_RSP[] = {
+    0x0b, 0x09, 'R', 'u', 'u', 'v', 'i', ' ', '0', '0', '0', '1',
+};
+
+static const uint8_t RUUVI_MAC[6] = {0xC1, 0x00, 0x00, 0x00, 0x00, 0x01};
+static const uint8_t BTHOME_MAC[6] = {0xC1, 0x00, 0x00, 0x00, 0x00, 0x02};
+
+struct Published {
+    size_t calls = 0;
+    std::string mac;
+    std::string json;
+};
+
+static size_t drain(Published &out, size_t maxItems = 16) {
+    return BLEScanner::instance().processBatch(maxItems, 0,
+    [&](JsonDocument &doc, const char *mac) {
+        out.calls++;
+        out.mac = mac;
+        out.json.clear();
+        serializeJson(doc, out.json);
+    });
+}
+
+// Unknown devices are remembered across tests, so each test uses its own
+// MAC prefix
+static void injectUnknown(uint8_t id, uint8_t prefix = 0xD0) {
+    uint8_t mac[6] = {prefix, 0x00, 0x00, 0x00, 0x00, id};
+    BLEScanner::instance().injectAdvert(mac, -70, UNKNOWN_AD, sizeof(UNKNOWN_AD));
+}
+
+void setUp() {
+    // each test starts with an empty queue
+    Published ignored;
+    while (drain(ignored))
+        ;
+}
+
+void tearDown() {}
+
+static void test_ruuvi_decoded() {
+    auto &scanner = BLEScanner::instance();
+    scanner.injectAdvert(RUUVI_MAC, -60, RUUVI_AD, sizeof(RUUVI_AD));
+
+    JsonDocument doc;
+    char mac[13];
+    TEST_ASSERT_TRUE(scanner.process(doc, mac, sizeof(mac)));
+    TEST_ASSERT_EQUAL_STRING("C10000000001", mac);
+    TEST_ASSERT_EQUAL_STRING("Ruuvi", doc["dev"].as<const char *>());
+    TEST_ASSERT_EQUAL_STRING("C1:00:00:00:00:01", doc["mac"].as<const char *>());
+    TEST_ASSERT_EQUAL_INT(-60, doc["rssi"].as<int>());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 24.3, doc["temp"].as<double>());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 53.49, doc["hum"].as<double>());
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 1000.44, doc["press"].as<double>());
+    TEST_ASSERT_TRUE(doc["mfd"].isNull());
+    TEST_ASSERT_FALSE(scanner.process(doc, mac, sizeof(mac)));
+
+    DeviceTable *devices = scanner.devices();
+    TEST_ASSERT_NOT_NULL(devices);
+    DeviceInfo info;
+    TEST_ASSERT_TRUE(devices->find(RUUVI_MAC, info));
+    TEST_ASSERT_EQUAL_STRING("Ruuvi", info.dev);
+    const DeviceField *temp = info.field("temp");
+    TEST_ASSERT_NOT_NULL(temp);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 24.3f, temp->value);
+}
+
+static void test_bthome_decoded() {
+    auto &scanner = BLEScanner::instance();
+    scanner.injectAdvert(BTHOME_MAC, -55, BTHOME_AD, sizeof(BTHOME_AD));
+
+    JsonDocument doc;
+    char mac[13];
+    TEST_ASSERT_TRUE(scanner.process(doc, mac, sizeof(mac)));
+    TEST_ASSERT_EQUAL_STRING("C10000000002", mac);
+    TEST_ASSERT_EQUAL_INT(2, doc["bthome_version"].as<int>());
+    TEST_ASSERT_EQUAL_size_t(2, doc["measurements"].size());
+    TEST_ASSERT_EQUAL_INT(0x01, doc["measurements"][0]["object_id"].as<int>());
+    TEST_ASSERT_EQUAL_STRING("battery_percent", doc["measurements"][0]["name"].as<const char *>());
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 93.0f, doc["measurements"][0]["value"].as<float>());
+    TEST_ASSERT_EQUAL_STRING("temperature", doc["measurements"][1]["name"].as<const char *>());
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 25.06f, doc["measurements"][1]["value"].as<float>());
+}
+
+// With setRawUnknown(false) undecoded adverts are consumed without a
+// handler call but still count against the batch budget.
+static void test_batch_budget_counts_silent_items() {
+    auto &scanner = BLEScanner::instance();
+    for (uint8_t i = 1; i <= 5; i++)
+        injectUnknown(i);
+    scanner.injectAdvert(RUUVI_MAC, -60, RUUVI_AD, sizeof(RUUVI_AD));
+
+    Published out;
+    TEST_ASSERT_EQUAL_size_t(3, drain(out, 3));
+    TEST_ASSERT_EQUAL_size_t(0, out.calls);
+
+    TEST_ASSERT_EQUAL_size_t(3, drain(out, 16));
+    TEST_ASSERT_EQUAL_size_t(1, out.calls);
+    TEST_ASSERT_EQUAL_STRING("C10000000001", out.mac.c_str());
+    TEST_ASSERT_TRUE(out.json.find("\"dev\":\"Ruuvi\"") != std::string::npos);
+
+    TEST_ASSERT_EQUAL_size_t(0, drain(out, 16));
+}
+
+static void test_unknown_summary() {
+    auto &scanner = BLEScanner::instance();
+    JsonDocument doc;
+    size_t before = scanner.unknownSummary(doc, 0);
+
+    for (uint8_t i = 1; i <= 3; i++)
+        injectUnknown(i, 0xE0);
+    injectUnknown(3, 0xE0);
+    injectUnknown(9, 0xE0);
+    Published out;
+    drain(out);
+
+    size_t count = scanner.unknownSummary(doc, 2);
+    // E0..01-03 and E0..09 are new, the repeat of E0..03 is not
+    TEST_ASSERT_EQUAL_size_t(before + 4, count);
+    TEST_ASSERT_EQUAL_size_t(before + 4, doc["count"].as<size_t>());
+    TEST_ASSERT_EQUAL_size_t(2, doc["devices"].size());
+
+    JsonVariant newest = doc["devices"][0];
+    TEST_ASSERT_EQUAL_STRING("E00000000009", newest["mac"].as<const char *>());
+    TEST_ASSERT_EQUAL_INT(1, newest["n"].as<int>());
+    TEST_ASSERT_EQUAL_INT(0x1234, newest["cid"].as<int>());
+    TEST_ASSERT_EQUAL_INT(-70, newest["rmax"].as<int>());
+    uint64_t first = newest["first"].as<uint64_t>();
+    uint64_t last = newest["last"].as<uint64_t>();
+    TEST_ASSERT_TRUE(first > 0 && first == last);
+    JsonVariant repeated = doc["devices"][1];
+    TEST_ASSERT_EQUAL_STRING("E00000000003", repeated["mac"].as<const char *>());
+    TEST_ASSERT_EQUAL_INT(2, repeated["n"].as<int>());
+}
+
+static void test_stats_count_consumed_items() {
+    auto &scanner = BLEScanner::instance();
+    BLEScanner::Stats before = scanner.stats();
+    injectUnknown(7);
+    scanner.injectAdvert(BTHOME_MAC, -55, BTHOME_AD, sizeof(BTHOME_AD));
+    Published out;
+    TEST_ASSERT_EQUAL_size_t(2, drain(out));
+
+    BLEScanner::Stats after = scanner.stats();
+    TEST_ASSERT_EQUAL_UINT32(2, after.received - before.received);
+    TEST_ASSERT_EQUAL_UINT32(1, after.decoded - before.decoded);
+}
+
+static void test_filter_rule_hits() {
+    auto &scanner = BLEScanner::instance();
+    AdvFilter filter;
+    filter.denyCompany(0x1234);
+    filter.denyMac(RUUVI_MAC);
+    filter.allowServiceUuid(0xFCD2);
+    scanner.setFilter(filter);
+
+    BLEScanner::Stats before = scanner.stats();
+    injectUnknown(5);
+    injectUnknown(6);
+    scanner.injectAdvert(BTHOME_MAC, -55, BTHOME_AD, sizeof(BTHOME_AD));
+    Published out;
+    TEST_ASSERT_EQUAL_size_t(1, drain(out));
+    BLEScanner::Stats after = scanner.stats();
+    TEST_ASSERT_EQUAL_UINT32(2, after.filterCompany - before.filterCompany);
+
+    AdvFilter::RuleHits rules[4];
+    TEST_ASSERT_EQUAL_size_t(3, scanner.filterHits(rules, 4));
+    TEST_ASSERT_EQUAL(AdvFilter::RuleHits::MAC, rules[0].kind);
+    TEST_ASSERT_EQUAL_UINT32(0, rules[0].hits);
+    TEST_ASSERT_EQUAL(AdvFilter::RuleHits::COMPANY, rules[1].kind);
+    TEST_ASSERT_FALSE(rules[1].allow);
+    TEST_ASSERT_EQUAL_UINT64(0x1234, rules[1].key);
+    TEST_ASSERT_EQUAL_UINT32(2, rules[1].hits);
+    TEST_ASSERT_EQUAL(AdvFilter::RuleHits::UUID, rules[2].kind);
+    TEST_ASSERT_TRUE(rules[2].allow);
+    TEST_ASSERT_EQUAL_UINT32(1, rules[2].hits);
+
+    scanner.setFilter(AdvFilter());
+    TEST_ASSERT_EQUAL_size_t(0, scanner.filterHits(rules, 4));
+}
+
+// Only a result the GAP event marks as a scan response joins a held
+// scannable advert; an advert without Flags is not mistaken for one.
+static void test_scan_response_merge() {
+    auto &scanner = BLEScanner::instance();
+    const uint8_t mac[6] = {0xF0, 0x00, 0x00, 0x00, 0x00, 0x01};
+    BLEScanner::Stats before = scanner.stats();
+    Published out;
+
+    scanner.injectAdvert(mac, -60, RUUVI_AD, sizeof(RUUVI_AD), ADV_FLAG_SCANNABLE);
+    TEST_ASSERT_EQUAL_size_t(0, drain(out));
+    scanner.injectAdvert(mac, -60, NAME_RSP, sizeof(NAME_RSP), ADV_FLAG_SCAN_RSP);
+    TEST_ASSERT_EQUAL_size_t(1, drain(out));
+    TEST_ASSERT_TRUE(out.json.find("\"dev\":\"Ruuvi\"") != std::string::npos);
+    DeviceInfo info;
+    TEST_ASSERT_TRUE(scanner.devices()->find(mac, info));
+    TEST_ASSERT_EQUAL_STRING("Ruuvi 0001", info.name);
+
+    scanner.injectAdvert(mac, -60, RUUVI_AD, sizeof(RUUVI_AD), ADV_FLAG_SCANNABLE);
+    scanner.injectAdvert(mac, -60, UNKNOWN_AD + 3, sizeof(UNKNOWN_AD) - 3);
+    TEST_ASSERT_EQUAL_size_t(2, drain(out));
+
+    BLEScanner::Stats after = scanner.stats();
+    TEST_ASSERT_EQUAL_UINT32(1, after.scanMerged - before.scanMerged);
+    TEST_ASSERT_EQUAL_UINT32(1, after.scanUnmatched - before.scanUnmatched);
+}
+
+int main() {
+    auto &scanner = BLEScanner::instance();
+    scanner.setDeviceTable(16);
+    scanner.setRawUnknown(false);
+    scanner.setActiveScan(true);
+    scanner.setScanResponseMerge(60000, 4);
+    scanner.begin(16384);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_ruuvi_decoded);
+    RUN_TEST(test_bthome_decoded);
+    RUN_TEST(test_batch_budget_counts_silent_items);
+    RUN_TEST(test_unknown_summary);
+    RUN_TEST(test_stats_count_consumed_items);
+    RUN_TEST(test_filter_rule_hits);
+    RUN_TEST(test_scan_response_merge);
+    return UNITY_END();
+}